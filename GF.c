@@ -1,26 +1,180 @@
 #include "GF.h"
 
+#include <linux/errno.h>
 #include <linux/types.h>
 #include <linux/slab.h>
 
+#include "GF2w.h"
 #include "poly.h"
 #include "utils.h"
 
 // x^8 + x^4 + x^3 + x^2 + 1
 uint8_t IGF2_8_coeff[9] = {1, 0, 1, 1, 1, 0, 0, 0, 1};
 poly_t IGF2_8 = {.deg = 8, .coeff = IGF2_8_coeff};
-GF_t GF2_8 = {.p = 2, .I = &IGF2_8};
+GF_t GF2_8 = {.p = 2, .I = &IGF2_8, .packed = true, .Iw = 0x1d};
 
 // x^16 + x^9 + x^8 + x^7 + x^6 + x^4 + x^3 + x^2 + 1
 uint8_t IGF2_16_coeff[17] = {1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1};
 poly_t IGF2_16 = {.deg = 16, .coeff = IGF2_16_coeff};
-GF_t GF2_16 = {.p = 2, .I = &IGF2_16};
+GF_t GF2_16 = {.p = 2, .I = &IGF2_16, .packed = true, .Iw = 0x3dd};
 
 // x^32 + x^22 + x^2 + x^1 + 1
 uint8_t IGF2_32_coeff[33] = {1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                              0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
 poly_t IGF2_32 = {.deg = 32, .coeff = IGF2_32_coeff};
-GF_t GF2_32 = {.p = 2, .I = &IGF2_32};
+GF_t GF2_32 = {.p = 2, .I = &IGF2_32, .packed = true, .Iw = 0x400007};
+
+// Log/antilog tables of GF2_8 with respect to a generator of its
+// multiplicative group. Exp is doubled so that log[a] + log[b] needs no mod.
+static uint8_t GF2_8_log[256];
+static uint8_t GF2_8_exp[2 * 255];
+static bool GF2_8_tables_ready = false;
+
+uint8_t GF2_8_nibble[256][32] __attribute__((aligned(32)));
+
+void GF_init_tables(void) {
+  poly_init_tables();
+  if (GF2_8_tables_ready) {
+    return;
+  }
+  // Find a generator of the multiplicative group of order 255.
+  uint8_t g = 2;
+  for (;; ++g) {
+    uint8_t x = g;
+    size_t ord = 1;
+    while (x != 1) {
+      x = GF2w_mul(x, g, GF2_8.I->deg, GF2_8.Iw);
+      ord++;
+    }
+    if (ord == 255) {
+      break;
+    }
+  }
+  uint8_t x = 1;
+  for (size_t i = 0; i < 255; ++i) {
+    GF2_8_exp[i] = x;
+    GF2_8_exp[i + 255] = x;
+    GF2_8_log[x] = i;
+    x = GF2w_mul(x, g, GF2_8.I->deg, GF2_8.Iw);
+  }
+  for (size_t c = 0; c < 256; ++c) {
+    for (size_t i = 0; i < 16; ++i) {
+      GF2_8_nibble[c][i] = GF2w_mul(c, i, GF2_8.I->deg, GF2_8.Iw);
+      GF2_8_nibble[c][16 + i] = GF2w_mul(c, i << 4, GF2_8.I->deg, GF2_8.Iw);
+    }
+  }
+  GF2_8_tables_ready = true;
+}
+
+// Return true if the fields are the same object or equal.
+static inline bool GF_same(const GF_t *F, const GF_t *K) {
+  return (F == K) || GF_eq(F, K);
+}
+
+// Return true if products over GF may be taken from the GF2_8 tables.
+static inline bool GF_has_tables(const GF_t *GF) {
+  return GF2_8_tables_ready && GF_same(GF, &GF2_8);
+}
+
+uint32_t GF_packed_mul(const GF_t *GF, uint32_t a, uint32_t b) {
+  if (GF_has_tables(GF)) {
+    if (!a || !b) {
+      return 0;
+    }
+    return GF2_8_exp[GF2_8_log[a] + GF2_8_log[b]];
+  }
+  return GF2w_mul(a, b, GF->I->deg, GF->Iw);
+}
+
+uint32_t GF_packed_dot(const GF_t *GF, const uint32_t *a, const uint32_t *b, size_t n) {
+  if (GF_has_tables(GF)) {
+    uint32_t res = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (a[i] && b[i]) {
+        res ^= GF2_8_exp[GF2_8_log[a[i]] + GF2_8_log[b[i]]];
+      }
+    }
+    return res;
+  }
+  // Reduction is linear, so the sum of the carry-less products, of degree
+  // below 2m like each of them, can be reduced once at the end.
+  uint64_t acc = 0;
+  for (size_t i = 0; i < n; ++i) {
+    acc ^= GF2w_clmul(a[i], b[i]);
+  }
+  return GF2w_reduce(acc, GF->I->deg, GF->Iw);
+}
+
+static inline uint32_t GF_word_inverse(const GF_t *GF, uint32_t a) {
+  if (GF_has_tables(GF)) {
+    return GF2_8_exp[255 - GF2_8_log[a]];
+  }
+  return GF2w_inverse(a, GF->I->deg, GF->Iw);
+}
+
+// Pack the coefficients of a polynomial over GF(2) into a word.
+static uint32_t poly_to_word(const poly_t *a) {
+  uint32_t res = 0;
+  for (size_t i = 0; i <= a->deg; ++i) {
+    res |= (uint32_t)(a->coeff[i] & 1) << i;
+  }
+  return res;
+}
+
+// Bytes an element of GF takes. Unless GF is packed, the element is
+// followed by its polynomial and room for 2 * deg(I) coefficients, so
+// that one allocation holds all of it.
+static size_t GF_elem_size(const GF_t *GF) {
+  if (GF->packed) {
+    return sizeof(GF_elem_t);
+  }
+  return sizeof(GF_elem_t) + sizeof(poly_t) + 2 * (size_t)GF->I->deg;
+}
+
+// Set a to zero, with its polynomial, if any, at poly and its
+// coefficients at coeff.
+static void GF_elem_init_zero(GF_elem_t *a, GF_t *GF, poly_t *poly, uint8_t *coeff) {
+  a->GF = GF;
+  if (GF->packed) {
+    a->word = 0;
+    return;
+  }
+  poly->deg = 0;
+  poly->coeff = memset(coeff, 0, 2 * (size_t)GF->I->deg);
+  a->poly = poly;
+}
+
+// Allocate a zero element of GF.
+static GF_elem_t *GF_elem_alloc(GF_t *GF) {
+  GF_elem_t *res = xkmalloc(GF_elem_size(GF));
+  if (res) {
+    poly_t *poly = (poly_t *)(res + 1);
+    GF_elem_init_zero(res, GF, poly, (uint8_t *)(poly + 1));
+  }
+  return res;
+}
+
+// Allocate a zero polynomial of length 2 * deg(I), which is enough to hold
+// the product of two elements of GF before reduction.
+static poly_t *GF_poly_alloc(GF_t *GF) {
+  return poly_create_zero(2 * GF->I->deg);
+}
+
+// Set res = a * b mod (I) using tmp, of length 2 * deg(I), for the full
+// product. res may be a or b.
+static void GF_poly_mulmod(GF_t *GF, poly_t *res, poly_t *a, poly_t *b, poly_t *tmp) {
+  poly_mul_scratch(tmp, a, b, GF->p, NULL);
+  poly_div(res, tmp, GF->I, GF->p);
+}
+
+static inline bool GF_poly_is_zero(const poly_t *a) {
+  return (a->deg == 0) && (*a->coeff == 0);
+}
+
+static void GF_poly_set(poly_t *res, const poly_t *a) {
+  memcpy(res->coeff, a->coeff, sizeof(*a->coeff) * (a->deg + 1));
+  res->deg = a->deg;
+}
 
 GF_t *GF_init_field(uint8_t p, poly_t I) {
   GF_t *GF = xkmalloc(sizeof(*GF));
@@ -32,6 +186,13 @@ GF_t *GF_init_field(uint8_t p, poly_t I) {
   }
   GF->p = p;
   GF->I = a;
+  GF->packed = (p == 2) && (a->deg >= 1) && (a->deg <= 32);
+  if (GF->packed) {
+    // Drop the leading term x^deg.
+    GF->Iw = poly_to_word(a) & (uint32_t)(((uint64_t)1 << a->deg) - 1);
+  } else {
+    GF->Iw = 0;
+  }
   return GF;
 }
 
@@ -44,18 +205,59 @@ void GF_destroy_field(GF_t *GF) {
 
 void GF_elem_destroy(GF_elem_t *a) {
   if (a) {
-    poly_destroy(a->poly);
     kfree(a);
   }
 }
 
+GF_elem_t *GF_elem_array_create(GF_t *GF, size_t n) {
+  if (!GF || !n) {
+    return NULL;
+  }
+  GF_elem_t *res = xkcalloc(n, GF_elem_size(GF));
+  if (!res) {
+    return NULL;
+  }
+  // The polynomials follow the elements, and their coefficients follow them.
+  poly_t *poly = (poly_t *)(res + n);
+  uint8_t *coeff = (uint8_t *)(poly + n);
+  for (size_t i = 0; i < n; ++i) {
+    GF_elem_init_zero(&res[i], GF, &poly[i], coeff + 2 * (size_t)GF->I->deg * i);
+  }
+  return res;
+}
+
+void GF_elem_array_destroy(GF_elem_t *a) {
+  kfree(a);
+}
+
 GF_elem_t *GF_elem_cpy(GF_elem_t *a) {
   GF_elem_t *res = GF_elem_get_neutral(a->GF);
+  if (!res) {
+    return NULL;
+  }
+  if (a->GF->packed) {
+    res->word = a->word;
+    return res;
+  }
   memcpy(res->poly->coeff, a->poly->coeff, a->GF->I->deg * sizeof(*a->poly->coeff));
   res->poly->deg = a->poly->deg;
   return res;
 }
 
+void GF_elem_set(GF_elem_t *res, GF_elem_t *a) {
+  if (res->GF->packed) {
+    res->word = a->word;
+    return;
+  }
+  memcpy(res->poly->coeff, a->poly->coeff, a->GF->I->deg * sizeof(*a->poly->coeff));
+  res->poly->deg = a->poly->deg;
+}
+
+void GF_elem_init_packed(GF_elem_t *a, GF_t *GF, uint32_t x) {
+  a->GF = GF;
+  a->word = x;
+}
+
 bool GF_eq(const GF_t *F, const GF_t *K) {
   // Irreducible polynomials must match.
   bool ret = poly_eq(F->I, K->I);
@@ -74,32 +276,32 @@ GF_elem_t *GF_elem_from_array(uint8_t deg, uint8_t *coeff, GF_t *GF) {
     return NULL;
   }
 
-  GF_elem_t *a = xkmalloc(sizeof(*a));
-  poly_t *poly = poly_from_array(deg, coeff);
-  if (!a || !poly) {
-    kfree(a);
-    poly_destroy(poly);
+  GF_elem_t *a = GF_elem_get_neutral(GF);
+  if (!a) {
     return NULL;
   }
 
+  // Reduce a copy on the stack, so that the element is the only allocation.
+  uint8_t buf[256];
+  poly_t poly = {.deg = deg, .coeff = buf};
+
   // Set coefficients mod p and normalize degree.
-  for (size_t i = 0; i <= poly->deg; ++i) {
-    poly->coeff[i] %= GF->p;
+  for (size_t i = 0; i <= deg; ++i) {
+    buf[i] = coeff[i] % GF->p;
   }
-  poly_normalize_deg(poly);
+  poly_normalize_deg(&poly);
 
   // Redduce polynomial over GF(p)[X]/(I).
-  if (poly->deg >= GF->I->deg) {
-    poly_div(poly, poly, GF->I, GF->p);
+  if (poly.deg >= GF->I->deg) {
+    poly_div(&poly, &poly, GF->I, GF->p);
   }
 
-  uint8_t *buff = xkcalloc(GF->I->deg, sizeof(*coeff));
-  memcpy(buff, poly->coeff, sizeof(*poly->coeff) * (poly->deg + 1));
-  kfree(poly->coeff);
-
-  poly->coeff = buff;
-  a->GF = GF;
-  a->poly = poly;
+  if (GF->packed) {
+    a->word = poly_to_word(&poly);
+  } else {
+    memcpy(a->poly->coeff, poly.coeff, sizeof(*poly.coeff) * (poly.deg + 1));
+    a->poly->deg = poly.deg;
+  }
   return a;
 }
 
@@ -107,16 +309,7 @@ GF_elem_t *GF_elem_get_neutral(GF_t *GF) {
   if (!GF) {
     return NULL;
   }
-  GF_elem_t *neutral = xkmalloc(sizeof(*neutral));
-  poly_t *poly = poly_create_zero(GF->I->deg);
-  if (!neutral || !poly) {
-    kfree(neutral);
-    poly_destroy(poly);
-    return NULL;
-  }
-  neutral->GF = GF;
-  neutral->poly = poly;
-  return neutral;
+  return GF_elem_alloc(GF);
 }
 
 GF_elem_t *GF_elem_get_unity(GF_t *GF) {
@@ -126,7 +319,11 @@ GF_elem_t *GF_elem_get_unity(GF_t *GF) {
     GF_elem_destroy(unity);
     return NULL;
   }
-  *unity->poly->coeff = 1;
+  if (GF->packed) {
+    unity->word = 1;
+  } else {
+    *unity->poly->coeff = 1;
+  }
   return unity;
 }
 
@@ -135,6 +332,11 @@ GF_elem_t *GF_elem_get_complement(GF_elem_t *a) {
   if (!res) {
     return NULL;
   }
+  // In characteristic 2 every element is its own complement.
+  if (a->GF->packed) {
+    res->word = a->word;
+    return res;
+  }
   for (size_t i = 0; i < a->GF->I->deg; ++i) {
     res->poly->coeff[i] = complement(a->poly->coeff[i], a->GF->p);
   }
@@ -143,98 +345,73 @@ GF_elem_t *GF_elem_get_complement(GF_elem_t *a) {
 }
 
 GF_elem_t *GF_elem_get_inverse(GF_elem_t *a) {
+  if (a->GF->packed) {
+    if (!a->word) {
+      return NULL;
+    }
+    GF_elem_t *res = GF_elem_get_neutral(a->GF);
+    if (!res) {
+      return NULL;
+    }
+    res->word = GF_word_inverse(a->GF, a->word);
+    return res;
+  }
   if ((a->poly->deg == 0) && (*a->poly->coeff == 0)) {
     return NULL;
   }
-  uint64_t mul_group_ord = fpow(a->GF->p, a->GF->I->deg) - 2;
   GF_elem_t *res = GF_elem_get_neutral(a->GF);
   if (!res) {
     return NULL;
   }
-  poly_fpowm(res->poly, a->poly, mul_group_ord, a->GF->I, a->GF->p);
+  poly_inverse(res->poly, a->poly, a->GF->I, a->GF->p, NULL);
   return res;
 }
 
 GF_elem_t *GF_elem_from_uint8(uint8_t x) {
   GF_elem_t *res = GF_elem_get_neutral(&GF2_8);
-  uint8_t d;
-  res->poly->deg = 7;
-  size_t i = 0;
-  while (x > 0) {
-    d = x % 2;
-    res->poly->coeff[i] = d;
-    x /= 2;
-    i++;
-  }
-  poly_normalize_deg(res->poly);
+  if (res) {
+    res->word = x;
+  }
   return res;
 }
 
 uint8_t GF_elem_to_uint8(GF_elem_t *a) {
-  uint8_t res = 0;
-  uint8_t factor = 1;
-  for (size_t i = 0; i < a->GF->I->deg; ++i) {
-    res += factor * a->poly->coeff[i];
-    factor *= 2;
-  }
-  return res;
+  return a->word;
 }
 
 GF_elem_t *GF_elem_from_uint16(uint16_t x) {
   GF_elem_t *res = GF_elem_get_neutral(&GF2_16);
-  uint8_t d;
-  res->poly->deg = 15;
-  size_t i = 0;
-  while (x > 0) {
-    d = x % 2;
-    res->poly->coeff[i] = d;
-    x /= 2;
-    i++;
-  }
-  poly_normalize_deg(res->poly);
+  if (res) {
+    res->word = x;
+  }
   return res;
 }
 
 uint16_t GF_elem_to_uint16(GF_elem_t *a) {
-  uint8_t res = 0;
-  uint8_t factor = 1;
-  for (size_t i = 0; i < a->GF->I->deg; ++i) {
-    res += factor * a->poly->coeff[i];
-    factor *= 2;
-  }
-  return res;
+  return a->word;
 }
 
 GF_elem_t *GF_elem_from_uint32(uint32_t x) {
   GF_elem_t *res = GF_elem_get_neutral(&GF2_32);
-  uint8_t d;
-  res->poly->deg = 31;
-  size_t i = 0;
-  while (x > 0) {
-    d = x % 2;
-    res->poly->coeff[i] = d;
-    x /= 2;
-    i++;
-  }
-  poly_normalize_deg(res->poly);
+  if (res) {
+    res->word = x;
+  }
   return res;
 }
 
 uint32_t GF_elem_to_uint32(GF_elem_t *a) {
-  uint8_t res = 0;
-  uint8_t factor = 1;
-  for (size_t i = 0; i < a->GF->I->deg; ++i) {
-    res += factor * a->poly->coeff[i];
-    factor *= 2;
-  }
-  return res;
+  return a->word;
 }
 
 void GF_elem_sum(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b) {
   if (!res) {
     return;
   }
-  if (!GF_eq(res->GF, a->GF) && !GF_eq(res->GF, b->GF)) {
+  if (!GF_same(res->GF, a->GF) && !GF_same(res->GF, b->GF)) {
+    return;
+  }
+  if (res->GF->packed) {
+    res->word = a->word ^ b->word;
     return;
   }
   poly_sum(res->poly, a->poly, b->poly, res->GF->p);
@@ -246,28 +423,44 @@ void GF_elem_prod(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b) {
   }
 
   // Different fields.
-  if (!GF_eq(res->GF, a->GF) && !GF_eq(res->GF, b->GF)) {
+  if (!GF_same(res->GF, a->GF) && !GF_same(res->GF, b->GF)) {
     return;
   }
 
-  poly_t *tmp = poly_create_zero(a->poly->deg + b->poly->deg + 1);
-  if (!tmp) {
+  if (res->GF->packed) {
+    res->word = GF_packed_mul(res->GF, a->word, b->word);
     return;
   }
 
-  poly_mul(tmp, a->poly, b->poly, res->GF->p);
+  poly_t *tmp = GF_poly_alloc(res->GF);
+  if (!tmp) {
+    return;
+  }
 
-  memmove(res->poly->coeff, tmp->coeff, sizeof(*tmp->coeff) * (tmp->deg + 1));
-  res->poly->deg = tmp->deg;
+  GF_poly_mulmod(res->GF, res->poly, a->poly, b->poly, tmp);
 
   poly_destroy(tmp);
 }
 
 void GF_elem_div(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b) {
-  if (!res || ((b->poly->deg == 0) && (*b->poly->coeff == 0))) {
+  if (!res) {
+    return;
+  }
+  if (!GF_same(res->GF, a->GF) && !GF_same(res->GF, b->GF)) {
     return;
   }
-  if (!GF_eq(res->GF, a->GF) && !GF_eq(res->GF, b->GF)) {
+  if (res->GF->packed) {
+    if (!b->word) {
+      return;
+    }
+    if (GF_has_tables(res->GF)) {
+      res->word = a->word ? GF2_8_exp[GF2_8_log[a->word] + 255 - GF2_8_log[b->word]] : 0;
+      return;
+    }
+    res->word = GF_packed_mul(res->GF, a->word, GF_word_inverse(res->GF, b->word));
+    return;
+  }
+  if ((b->poly->deg == 0) && (*b->poly->coeff == 0)) {
     return;
   }
   GF_elem_t *inv_b = GF_elem_get_inverse(b);
@@ -282,7 +475,180 @@ void GF_elem_diff(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b) {
   if (!res) {
     return;
   }
-  GF_elem_t *negb = GF_elem_get_complement(b);
-  GF_elem_sum(res, a, negb);
-  GF_elem_destroy(negb);
+  // Subtraction is addition in characteristic 2.
+  if (res->GF->packed) {
+    GF_elem_sum(res, a, b);
+    return;
+  }
+  if (!GF_same(res->GF, a->GF) && !GF_same(res->GF, b->GF)) {
+    return;
+  }
+  poly_diff(res->poly, a->poly, b->poly, res->GF->p);
+}
+
+static int GF_batch_inverse_packed(GF_t *GF, GF_elem_t *res, GF_elem_t *a, size_t n) {
+  uint32_t *prefix = xkcalloc(n, sizeof(*prefix));
+  if (!prefix) {
+    return -ENOMEM;
+  }
+
+  // Worth a SIMD section for the 3n carry-less products.
+  bool simd = !GF_has_tables(GF) && GF2w_simd_begin();
+
+  // prefix[i] is the product of the nonzero elements before a[i].
+  uint32_t acc = 1;
+  for (size_t i = 0; i < n; ++i) {
+    prefix[i] = acc;
+    if (a[i].word) {
+      acc = GF_packed_mul(GF, acc, a[i].word);
+    }
+  }
+
+  // Peel the elements off the inverse of the whole product, last first.
+  uint32_t inv = GF_word_inverse(GF, acc);
+  for (size_t i = n; i-- > 0;) {
+    uint32_t x = a[i].word;
+    if (!x) {
+      res[i].word = 0;
+      continue;
+    }
+    res[i].word = GF_packed_mul(GF, inv, prefix[i]);
+    inv = GF_packed_mul(GF, inv, x);
+  }
+
+  if (simd) {
+    GF2w_simd_end();
+  }
+  kfree(prefix);
+  return 0;
+}
+
+static int GF_batch_inverse_poly(GF_t *GF, GF_elem_t *res, GF_elem_t *a, size_t n) {
+  int ret = -ENOMEM;
+  GF_elem_t *prefix = GF_elem_array_create(GF, n);
+  poly_t *inv = GF_poly_alloc(GF);
+  poly_t *tmp = GF_poly_alloc(GF);
+  poly_t *acc = GF_poly_alloc(GF);
+  if (!prefix || !inv || !tmp || !acc) {
+    goto out;
+  }
+
+  *acc->coeff = 1;
+  for (size_t i = 0; i < n; ++i) {
+    GF_poly_set(prefix[i].poly, acc);
+    if (!GF_poly_is_zero(a[i].poly)) {
+      GF_poly_mulmod(GF, acc, acc, a[i].poly, tmp);
+    }
+  }
+
+  poly_inverse(inv, acc, GF->I, GF->p, NULL);
+  for (size_t i = n; i-- > 0;) {
+    if (GF_poly_is_zero(a[i].poly)) {
+      GF_poly_set(res[i].poly, a[i].poly);
+      continue;
+    }
+    // acc is free now. res[i] may be a[i], so write it last.
+    GF_poly_mulmod(GF, acc, inv, prefix[i].poly, tmp);
+    GF_poly_mulmod(GF, inv, inv, a[i].poly, tmp);
+    GF_poly_set(res[i].poly, acc);
+  }
+  ret = 0;
+
+out:
+  GF_elem_array_destroy(prefix);
+  poly_destroy(acc);
+  poly_destroy(tmp);
+  poly_destroy(inv);
+  return ret;
+}
+
+int GF_elem_batch_inverse(GF_elem_t *res, GF_elem_t *a, size_t n) {
+  if (!n) {
+    return 0;
+  }
+  if (a->GF->packed) {
+    return GF_batch_inverse_packed(a->GF, res, a, n);
+  }
+  return GF_batch_inverse_poly(a->GF, res, a, n);
+}
+
+int GF_elem_batch_div(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b, size_t n) {
+  int ret = GF_elem_batch_inverse(res, b, n);
+  if (ret) {
+    return ret;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    GF_elem_prod(&res[i], &a[i], &res[i]);
+  }
+  return 0;
+}
+
+static int GF_dot_poly(GF_t *GF, GF_elem_t *res, GF_elem_t *a, GF_elem_t *b, size_t n) {
+  uint8_t p = GF->p;
+  size_t len = 2 * GF->I->deg - 1;
+  uint32_t *acc = xkcalloc(len, sizeof(*acc));
+  poly_t *tmp = GF_poly_alloc(GF);
+  if (!acc || !tmp) {
+    kfree(acc);
+    poly_destroy(tmp);
+    return -ENOMEM;
+  }
+
+  // A term adds at most deg(I) products below p^2 to a coefficient, so
+  // that many terms fit before the sums must be brought back below p.
+  uint32_t sq = (uint32_t)(p - 1) * (p - 1);
+  size_t room = ((uint32_t)-1 - p) / (sq * GF->I->deg);
+  size_t terms = 0;
+  for (size_t k = 0; k < n; ++k) {
+    poly_t *u = a[k].poly;
+    poly_t *v = b[k].poly;
+    if (terms++ == room) {
+      for (size_t i = 0; i < len; ++i) {
+        acc[i] %= p;
+      }
+      terms = 1;
+    }
+    for (size_t i = 0; i <= u->deg; ++i) {
+      for (size_t j = 0; j <= v->deg; ++j) {
+        acc[i + j] += (uint32_t)u->coeff[i] * v->coeff[j];
+      }
+    }
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    tmp->coeff[i] = acc[i] % p;
+  }
+  tmp->deg = len - 1;
+  poly_normalize_deg(tmp);
+  poly_div(res->poly, tmp, GF->I, p);
+
+  poly_destroy(tmp);
+  kfree(acc);
+  return 0;
+}
+
+int GF_elem_dot(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b, size_t n) {
+  GF_t *GF = res->GF;
+  if (GF->packed && GF_has_tables(GF)) {
+    uint32_t x = 0;
+    for (size_t k = 0; k < n; ++k) {
+      x ^= GF_packed_mul(GF, a[k].word, b[k].word);
+    }
+    res->word = x;
+    return 0;
+  }
+  if (GF->packed) {
+    // Worth a SIMD section for the carry-less products.
+    bool simd = GF2w_simd_begin();
+    uint64_t acc = 0;
+    for (size_t k = 0; k < n; ++k) {
+      acc ^= GF2w_clmul(a[k].word, b[k].word);
+    }
+    res->word = GF2w_reduce(acc, GF->I->deg, GF->Iw);
+    if (simd) {
+      GF2w_simd_end();
+    }
+    return 0;
+  }
+  return GF_dot_poly(GF, res, a, b, n);
 }
@@ -6,14 +6,20 @@
 
 // Galois field.
 typedef struct GF {
-  uint8_t p;  // Characteristic of the field GF(p).
-  poly_t *I;  // Irreducible polynomial over GF(p)[x].
+  uint8_t p;    // Characteristic of the field GF(p).
+  poly_t *I;    // Irreducible polynomial over GF(p)[x].
+  bool packed;  // Elements are packed into words (p = 2 and deg(I) <= 32).
+  uint32_t Iw;  // Lower terms of I packed into a word, if packed.
 } GF_t;
 
-// Element of the Galois field.
+// Element of the Galois field. Elements created by the functions below
+// hold their polynomial and its coefficients in the same allocation.
 typedef struct GF_elem {
-  GF_t *GF;      // Galois field.
-  poly_t *poly;  // Element of the GF(p)[x]/(I).
+  GF_t *GF;  // Galois field.
+  union {
+    poly_t *poly;   // Element of the GF(p)[x]/(I).
+    uint32_t word;  // Element of a packed field, see GF2w.h.
+  };
 } GF_elem_t;
 
 // x^8 + x^4 + x^3 + x^2 + 1
@@ -25,7 +31,17 @@ extern GF_t GF2_16;
 // x^32 + x^22 + x^2 + x^1 + 1
 extern GF_t GF2_32;
 
-/* Initialize GF(P)[x]/(I) */
+/* Split-nibble multiplication tables of GF2_8, for byte shuffles:
+   GF2_8_nibble[c][x] = c * x and GF2_8_nibble[c][16 + x] = c * (x << 4),
+   for x < 16. Filled by GF_init_tables. */
+extern uint8_t GF2_8_nibble[256][32];
+
+/* Build log/antilog and nibble tables for GF2_8, and the mod-p tables of
+   poly_init_tables. Until this is called, GF2_8 products go through the
+   carry-less multiply of GF2w.h. */
+void GF_init_tables(void);
+
+/* Initialize GF(P)[x]/(I). */
 GF_t *GF_init_field(uint8_t p, poly_t I);
 
 /* Destryo a field structure. */
@@ -35,6 +51,15 @@ void GF_destroy_field(GF_t *GF);
    The field itself is left untouched. */
 void GF_elem_destroy(GF_elem_t *a);
 
+/* Return n zero elements of GF in one allocation. The elements are
+   contiguous, and so are the coefficients of their polynomials, so that
+   arrays of elements of fields that are not packed can be walked without
+   pointer chasing across the heap. Free with GF_elem_array_destroy, not
+   GF_elem_destroy. */
+GF_elem_t *GF_elem_array_create(GF_t *GF, size_t n);
+
+void GF_elem_array_destroy(GF_elem_t *a);
+
 /* Given an array of polynomial coefficients of any length and GF(p)[x]/(I),
    Return an element over that field. */
 GF_elem_t *GF_elem_from_array(uint8_t deg, uint8_t *coeff, GF_t *GF);
@@ -55,6 +80,13 @@ bool GF_eq(const GF_t *F, const GF_t *K);
 /* Return a copy of an a. */
 GF_elem_t *GF_elem_cpy(GF_elem_t *a);
 
+/* Set res = a. Both must already be elements of the same field. */
+void GF_elem_set(GF_elem_t *res, GF_elem_t *a);
+
+/* Initialize an element of a packed field in caller-provided storage.
+   Such an element owns no memory and must not be destroyed. */
+void GF_elem_init_packed(GF_elem_t *a, GF_t *GF, uint32_t x);
+
 /* res = a + b mod (I). */
 void GF_elem_sum(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b);
 
@@ -64,6 +96,15 @@ void GF_elem_diff(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b);
 /* res = a * b mod (I). */
 void GF_elem_prod(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b);
 
+/* Return a * b mod (I) for elements of a packed field given as words. */
+uint32_t GF_packed_mul(const GF_t *GF, uint32_t a, uint32_t b);
+
+/* Return a[0] b[0] + ... + a[n - 1] b[n - 1] mod (I) for elements of a
+   packed field given as words. The products are summed before reduction,
+   so there is one reduction in all. Runs in the SIMD section of the caller,
+   if any. */
+uint32_t GF_packed_dot(const GF_t *GF, const uint32_t *a, const uint32_t *b, size_t n);
+
 /* Calculate res: a = b * res mod (I). */
 void GF_elem_div(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b);
 
@@ -73,6 +114,20 @@ GF_elem_t *GF_elem_get_complement(GF_elem_t *a);
 /* Calculate res: res * a = 1 mod (I). */
 GF_elem_t *GF_elem_get_inverse(GF_elem_t *a);
 
+/* Set res[i] = a[i]^-1 for i < n with a single field inversion (Montgomery's
+   trick), at the cost of 3 products per element. Zero elements give zero.
+   All elements must belong to the same field and res may be a.
+   Return 0, or -ENOMEM. */
+int GF_elem_batch_inverse(GF_elem_t *res, GF_elem_t *a, size_t n);
+
+/* Set res[i] = a[i] / b[i] for i < n, as GF_elem_batch_inverse. res may be b but not a. */
+int GF_elem_batch_div(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b, size_t n);
+
+/* res = a[0] * b[0] + ... + a[n - 1] * b[n - 1] mod (I), with the products
+   summed unreduced and a single reduction by I. All elements must belong
+   to the same field and res may be one of them. Return 0, or -ENOMEM. */
+int GF_elem_dot(GF_elem_t *res, GF_elem_t *a, GF_elem_t *b, size_t n);
+
 /* Return neutral element of the given finite field. */
 GF_elem_t *GF_elem_get_neutral(GF_t *GF);
 
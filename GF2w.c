@@ -0,0 +1,133 @@
+#include "GF2w.h"
+
+#include <linux/types.h>
+
+#ifdef CONFIG_X86_64
+#include <linux/percpu.h>
+#include <asm/cpufeature.h>
+#include <asm/fpu/api.h>
+#include <asm/simd.h>
+
+// Set while the current CPU is inside GF2w_simd_begin/end.
+static DEFINE_PER_CPU(bool, GF2w_simd_active);
+
+bool GF2w_simd_begin(void) {
+  if (!may_use_simd()) {
+    return false;
+  }
+  kernel_fpu_begin();
+  this_cpu_write(GF2w_simd_active, true);
+  return true;
+}
+
+void GF2w_simd_end(void) {
+  this_cpu_write(GF2w_simd_active, false);
+  kernel_fpu_end();
+}
+
+static inline bool GF2w_simd_enabled(void) {
+  return boot_cpu_has(X86_FEATURE_PCLMULQDQ) && this_cpu_read(GF2w_simd_active);
+}
+
+// The kernel is built without SSE, so the compiler never allocates xmm
+// registers itself and they need not be listed as clobbers.
+static inline uint64_t GF2w_clmul_simd(uint32_t a, uint32_t b) {
+  uint64_t res;
+  asm volatile("movq %1, %%xmm0\n\t"
+               "movq %2, %%xmm1\n\t"
+               "pclmulqdq $0x00, %%xmm1, %%xmm0\n\t"
+               "movq %%xmm0, %0"
+               : "=r"(res)
+               : "r"((uint64_t)a), "r"((uint64_t)b));
+  return res;
+}
+#else
+bool GF2w_simd_begin(void) {
+  return false;
+}
+
+void GF2w_simd_end(void) {}
+
+static inline bool GF2w_simd_enabled(void) {
+  return false;
+}
+
+static inline uint64_t GF2w_clmul_simd(uint32_t a, uint32_t b) {
+  return 0;
+}
+#endif
+
+uint64_t GF2w_clmul(uint32_t a, uint32_t b) {
+  if (GF2w_simd_enabled()) {
+    return GF2w_clmul_simd(a, b);
+  }
+  // Shift-and-xor fallback.
+  uint64_t res = 0;
+  uint64_t x = a;
+  while (b) {
+    if (b & 1) {
+      res ^= x;
+    }
+    x <<= 1;
+    b >>= 1;
+  }
+  return res;
+}
+
+uint32_t GF2w_reduce(uint64_t a, uint8_t m, uint32_t Iw) {
+  uint64_t mask = ((uint64_t)1 << m) - 1;
+  uint64_t hi;
+  // x^m = Iw mod (x^m + Iw), so fold the bits above x^m back with one
+  // carry-less product. Each round lowers the degree by m - deg(Iw).
+  while ((hi = a >> m)) {
+    a = (a & mask) ^ GF2w_clmul(hi, Iw);
+  }
+  return a;
+}
+
+uint32_t GF2w_mul(uint32_t a, uint32_t b, uint8_t m, uint32_t Iw) {
+  return GF2w_reduce(GF2w_clmul(a, b), m, Iw);
+}
+
+uint32_t GF2w_pow(uint32_t a, uint64_t exp, uint8_t m, uint32_t Iw) {
+  uint32_t res = 1;
+  while (exp > 0) {
+    if ((exp % 2) != 0) {
+      res = GF2w_mul(res, a, m, Iw);
+    }
+    a = GF2w_mul(a, a, m, Iw);
+    exp = exp / 2;
+  }
+  return res;
+}
+
+// Degree of a nonzero polynomial.
+static inline int GF2w_deg(uint64_t a) {
+  return 63 - __builtin_clzll(a);
+}
+
+uint32_t GF2w_inverse(uint32_t a, uint8_t m, uint32_t Iw) {
+  uint64_t u = a;
+  uint64_t v = ((uint64_t)1 << m) | Iw;
+  uint64_t g1 = 1;
+  uint64_t g2 = 0;
+  uint64_t tmp;
+  int j;
+  // Keep g1 * a = u and g2 * a = v mod (x^m + Iw). The degrees of g1 and
+  // g2 stay below m, so no reduction is needed.
+  while (u != 1) {
+    j = GF2w_deg(u) - GF2w_deg(v);
+    if (j < 0) {
+      tmp = u;
+      u = v;
+      v = tmp;
+      tmp = g1;
+      g1 = g2;
+      g2 = tmp;
+      j = -j;
+    }
+    u ^= v << j;
+    g1 ^= g2 << j;
+  }
+  return g1;
+}
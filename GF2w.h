@@ -0,0 +1,32 @@
+#pragma once
+
+#include <linux/types.h>
+
+/* Arithmetic of GF(2^m), m <= 32, on elements packed into machine words:
+   bit i of a word is the coefficient of x^i. The irreducible polynomial
+   x^m + Iw is given by its degree m and its lower terms Iw. */
+
+/* Return the carry-less product of a and b. */
+uint64_t GF2w_clmul(uint32_t a, uint32_t b);
+
+/* Return a mod (x^m + Iw). Assume deg(a) < 2m. */
+uint32_t GF2w_reduce(uint64_t a, uint8_t m, uint32_t Iw);
+
+/* Return a * b mod (x^m + Iw). */
+uint32_t GF2w_mul(uint32_t a, uint32_t b, uint8_t m, uint32_t Iw);
+
+/* Return a^exp mod (x^m + Iw). */
+uint32_t GF2w_pow(uint32_t a, uint64_t exp, uint8_t m, uint32_t Iw);
+
+/* Return a^-1 mod (x^m + Iw) by the extended Euclidean algorithm, in
+   O(m) word operations. a must be nonzero. */
+uint32_t GF2w_inverse(uint32_t a, uint8_t m, uint32_t Iw);
+
+/* Enter a section in which SIMD registers may be used, for instance by
+   GF2w_clmul for PCLMULQDQ. Return false if SIMD is not usable here, in
+   which case portable code is used and GF2w_simd_end must not be called.
+   The section must not sleep. */
+bool GF2w_simd_begin(void);
+
+/* Leave a section entered by a successful GF2w_simd_begin. */
+void GF2w_simd_end(void);
@@ -0,0 +1,867 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/types.h>
+
+#include "../GF.h"
+#include "../crs.h"
+#include "../crs_lanes.h"
+#include "../poly.h"
+
+#define ITERATIONS 1000000
+
+// Elements per GF_elem_batch_inverse call.
+#define BATCH 256
+
+// Size of the driver's staging buffer.
+#define STAGING_SIZE 4096
+
+// Seconds per read-loop measurement.
+#define READ_SECONDS 0.5
+
+// Nonzero coefficients of the sparse recurrences.
+#define SPARSE_TAPS 4
+
+// Order of the recurrence run in lanes, and bytes per lane of a block.
+#define LANES_ORD 16
+#define LANES_BLOCK 64
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Keeps results alive so the measured loops are not optimized away.
+static volatile uint8_t sink;
+
+// Number of self-checks that failed. Any makes the exit status nonzero.
+static int failures;
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  fprintf(stderr, "FAIL: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  ++failures;
+}
+
+static const struct {
+  const char *name;
+  GF_t *GF;
+} fields[] = {
+    {"GF2_8", &GF2_8},
+    {"GF2_16", &GF2_16},
+    {"GF2_32", &GF2_32},
+};
+
+// Odd characteristic fields, by their irreducible polynomial.
+static struct {
+  const char *name;
+  uint8_t p;
+  uint8_t deg;
+  uint8_t coeff[17];
+} odd_fields[] = {
+    {"GF3_16", 3, 16, {[0] = 2, [4] = 1, [16] = 1}},  // x^16 + x^4 + 2
+    {"GF5_12", 5, 12, {[0] = 4, [1] = 1, [12] = 1}},  // x^12 + x + 4
+    {"GF7_8", 7, 8, {[0] = 3, [1] = 1, [8] = 1}},     // x^8 + x + 3
+};
+
+#define ODD_FIELDS (sizeof(odd_fields) / sizeof(odd_fields[0]))
+
+// Return a random nonzero element of GF.
+static GF_elem_t *random_elem(GF_t *GF) {
+  uint8_t coeff[32];
+  uint8_t deg = GF->I->deg - 1;
+
+  do {
+    for (size_t i = 0; i <= deg; ++i) {
+      coeff[i] = rand() % GF->p;
+    }
+  } while (!memchr(coeff, 1, deg + 1));
+
+  return GF_elem_from_array(deg, coeff, GF);
+}
+
+// Return a random polynomial of degree deg over GF(p) with a nonzero leading term.
+static poly_t *random_poly(uint8_t deg, uint8_t p) {
+  uint8_t coeff[UINT8_MAX + 1];
+
+  for (size_t i = 0; i < deg; ++i) {
+    coeff[i] = rand() % p;
+  }
+  coeff[deg] = 1 + rand() % (p - 1);
+
+  return poly_from_array(deg, coeff);
+}
+
+static double bench_sum(GF_t *GF) {
+  GF_elem_t *a = random_elem(GF);
+  GF_elem_t *b = random_elem(GF);
+
+  double start = now();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    // Feed the result back so the loop cannot be hoisted.
+    GF_elem_sum(a, a, b);
+  }
+  double elapsed = now() - start;
+
+  GF_elem_destroy(a);
+  GF_elem_destroy(b);
+  return elapsed * 1e9 / ITERATIONS;
+}
+
+static double bench_prod(GF_t *GF) {
+  GF_elem_t *a = random_elem(GF);
+  GF_elem_t *b = random_elem(GF);
+  GF_elem_t *res = GF_elem_get_neutral(GF);
+
+  double start = now();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    GF_elem_prod(res, a, b);
+    GF_elem_prod(a, res, b);
+  }
+  double elapsed = now() - start;
+
+  GF_elem_destroy(a);
+  GF_elem_destroy(b);
+  GF_elem_destroy(res);
+  return elapsed * 1e9 / (2 * ITERATIONS);
+}
+
+static double bench_inverse(GF_t *GF) {
+  size_t iterations = ITERATIONS / 10;
+  GF_elem_t *a = random_elem(GF);
+  GF_elem_t *inv;
+
+  double start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    inv = GF_elem_get_inverse(a);
+    GF_elem_set(a, inv);
+    GF_elem_destroy(inv);
+  }
+  double elapsed = now() - start;
+
+  GF_elem_destroy(a);
+  return elapsed * 1e9 / iterations;
+}
+
+// Per element, inverting BATCH elements at a time.
+static double bench_batch_inverse(GF_t *GF) {
+  static GF_elem_t elems[BATCH];
+  size_t iterations = ITERATIONS / BATCH;
+  uint32_t mask = GF->I->deg == 32 ? ~0u : (1u << GF->I->deg) - 1;
+
+  for (size_t i = 0; i < BATCH; ++i) {
+    GF_elem_init_packed(&elems[i], GF, (rand() & mask) | 1);
+  }
+
+  double start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    GF_elem_batch_inverse(elems, elems, BATCH);
+  }
+  double elapsed = now() - start;
+
+  sink ^= elems[0].word;
+  return elapsed * 1e9 / (iterations * BATCH);
+}
+
+// Per term, over dot products of BATCH terms.
+static double bench_dot(GF_t *GF) {
+  static GF_elem_t a[BATCH], b[BATCH];
+  size_t iterations = ITERATIONS / BATCH;
+  uint32_t mask = GF->I->deg == 32 ? ~0u : (1u << GF->I->deg) - 1;
+
+  for (size_t i = 0; i < BATCH; ++i) {
+    GF_elem_init_packed(&a[i], GF, rand() & mask);
+    GF_elem_init_packed(&b[i], GF, rand() & mask);
+  }
+
+  double start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    GF_elem_dot(&a[i % BATCH], a, b, BATCH);
+  }
+  double elapsed = now() - start;
+
+  sink ^= a[0].word;
+  return elapsed * 1e9 / (iterations * BATCH);
+}
+
+static double bench_poly_mul(GF_t *GF) {
+  uint8_t deg = GF->I->deg - 1;
+  poly_t *a = random_poly(deg, 2);
+  poly_t *b = random_poly(deg, 2);
+  poly_t *res = poly_create_zero(2 * deg + 1);
+
+  double start = now();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    poly_mul(res, a, b, GF->p);
+    sink ^= res->coeff[i % (2 * deg + 1)];
+  }
+  double elapsed = now() - start;
+
+  poly_destroy(a);
+  poly_destroy(b);
+  poly_destroy(res);
+  return elapsed * 1e9 / ITERATIONS;
+}
+
+static double bench_poly_div(GF_t *GF) {
+  uint8_t deg = GF->I->deg;
+  poly_t *a = random_poly(2 * deg - 2, 2);
+  poly_t *res = poly_create_zero(2 * deg - 1);
+
+  double start = now();
+  for (size_t i = 0; i < ITERATIONS; ++i) {
+    poly_div(res, a, GF->I, GF->p);
+    sink ^= res->coeff[0];
+  }
+  double elapsed = now() - start;
+
+  poly_destroy(a);
+  poly_destroy(res);
+  return elapsed * 1e9 / ITERATIONS;
+}
+
+// a^(2^m - 2), the exponent of an inversion.
+static double bench_poly_fpowm(GF_t *GF) {
+  size_t iterations = ITERATIONS / 100;
+  uint8_t deg = GF->I->deg;
+  uint64_t exp = (1ULL << deg) - 2;
+  poly_t *a = random_poly(deg - 1, 2);
+  poly_t *res = poly_create_zero(2 * deg);
+  uint8_t buf[1024];
+  arena_t scratch;
+
+  arena_init(&scratch, buf, sizeof(buf));
+
+  double start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    poly_fpowm(res, a, exp, GF->I, GF->p, &scratch);
+    sink ^= res->coeff[0];
+  }
+  double elapsed = now() - start;
+
+  poly_destroy(a);
+  poly_destroy(res);
+  return elapsed * 1e9 / iterations;
+}
+
+// ns/op of poly_mul, poly_div and poly_inverse over an odd field, in res[0..2].
+static void bench_odd(size_t f, double *res) {
+  size_t iterations = ITERATIONS / 10;
+  uint8_t p = odd_fields[f].p;
+  poly_t I = {.deg = odd_fields[f].deg, .coeff = odd_fields[f].coeff};
+  poly_t *a = random_poly(I.deg - 1, p);
+  poly_t *b = random_poly(I.deg - 1, p);
+  poly_t *prod = poly_create_zero(2 * I.deg);
+  poly_t *rem = poly_create_zero(2 * I.deg);
+  uint8_t buf[1024];
+  arena_t scratch;
+  double start;
+
+  arena_init(&scratch, buf, sizeof(buf));
+  poly_mul(prod, a, b, p);
+
+  start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    poly_mul(rem, a, b, p);
+    sink ^= rem->coeff[i % (2 * I.deg - 1)];
+  }
+  res[0] = (now() - start) * 1e9 / iterations;
+
+  start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    poly_div(rem, prod, &I, p);
+    sink ^= rem->coeff[0];
+  }
+  res[1] = (now() - start) * 1e9 / iterations;
+
+  start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    poly_inverse(rem, a, &I, p, &scratch);
+    sink ^= rem->coeff[0];
+  }
+  res[2] = (now() - start) * 1e9 / iterations;
+
+  poly_destroy(a);
+  poly_destroy(b);
+  poly_destroy(prod);
+  poly_destroy(rem);
+}
+
+// ns/op of GF_elem_from_array and of GF_elem_cpy over an odd field, each
+// with the GF_elem_destroy of its result, in res[0..1].
+static void bench_odd_elem(size_t f, double *res) {
+  size_t iterations = ITERATIONS / 10;
+  poly_t I = {.deg = odd_fields[f].deg, .coeff = odd_fields[f].coeff};
+  GF_t *GF = GF_init_field(odd_fields[f].p, I);
+  GF_elem_t *a = random_elem(GF);
+  GF_elem_t *tmp;
+  uint8_t coeff[32];
+  double start;
+
+  for (size_t i = 0; i < I.deg; ++i) {
+    coeff[i] = rand() % GF->p;
+  }
+
+  start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    tmp = GF_elem_from_array(I.deg - 1, coeff, GF);
+    sink ^= tmp->poly->coeff[0];
+    GF_elem_destroy(tmp);
+  }
+  res[0] = (now() - start) * 1e9 / iterations;
+
+  start = now();
+  for (size_t i = 0; i < iterations; ++i) {
+    tmp = GF_elem_cpy(a);
+    sink ^= tmp->poly->coeff[0];
+    GF_elem_destroy(tmp);
+  }
+  res[1] = (now() - start) * 1e9 / iterations;
+
+  GF_elem_destroy(a);
+  GF_destroy_field(GF);
+}
+
+static const size_t karatsuba_degs[] = {15, 31, 47, 63, 95, 127};
+static const size_t karatsuba_mins[] = {16, 32, 48, 64};
+
+// ns/op of a product of two polynomials of degree deg over GF(3), by the
+// schoolbook method if min is 0 and otherwise by Karatsuba multiplication
+// down to factors of min coefficients. The best of several rounds, since
+// the differences are small.
+static double bench_karatsuba(uint8_t deg, size_t min) {
+  size_t iterations = ITERATIONS / 100;
+  double best = 0;
+  size_t saved = poly_karatsuba_min;
+  poly_t *a = random_poly(deg, 3);
+  poly_t *b = random_poly(deg, 3);
+  poly_t *res = poly_create_zero(2 * deg + 1);
+  uint8_t buf[4096];
+  arena_t scratch;
+
+  arena_init(&scratch, buf, sizeof(buf));
+  poly_karatsuba_min = min ? min : SIZE_MAX;
+
+  for (size_t round = 0; round < 5; ++round) {
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+      poly_mul_scratch(res, a, b, 3, &scratch);
+      sink ^= res->coeff[i % (2 * deg + 1)];
+    }
+    double elapsed = now() - start;
+    if (!round || (elapsed < best)) {
+      best = elapsed;
+    }
+  }
+
+  poly_karatsuba_min = saved;
+  poly_destroy(a);
+  poly_destroy(b);
+  poly_destroy(res);
+  return best * 1e9 / iterations;
+}
+
+// Bytes per second of the loop in rngdrv_read: generate a staging buffer,
+// then copy it out, for the recurrence of cfg.
+static double bench_stream(struct crs_cfg *cfg) {
+  static struct crs crs;
+  static uint8_t staging[STAGING_SIZE];
+  static uint8_t user[STAGING_SIZE];
+
+  crs_init(&crs);
+  crs_seed(&crs, cfg);
+
+  size_t done = 0;
+  double start = now();
+  double elapsed;
+  do {
+    for (size_t i = 0; i < 64; ++i) {
+      crs_generate(&crs, staging, STAGING_SIZE);
+      memcpy(user, staging, STAGING_SIZE);
+    }
+    done += 64 * STAGING_SIZE;
+    elapsed = now() - start;
+  } while (elapsed < READ_SECONDS);
+
+  crs_destroy(&crs);
+  sink ^= user[0];
+  return done / elapsed;
+}
+
+// Random nonzero packed element of GF.
+static uint32_t random_word(GF_t *GF) {
+  uint32_t mask = GF->I->deg == 32 ? ~0u : (1u << GF->I->deg) - 1;
+  uint32_t x;
+  do {
+    x = ((uint32_t)rand() << 16 ^ rand()) & mask;
+  } while (!x);
+  return x;
+}
+
+// bench_stream for a recurrence of order ord over GF with random coefficients.
+static double bench_read(GF_t *GF, size_t ord) {
+  static uint32_t coeffs[CRS_MAX_ORD];
+  static uint32_t vals[CRS_MAX_ORD];
+  struct crs_cfg cfg;
+
+  for (size_t i = 0; i < ord; ++i) {
+    coeffs[i] = random_word(GF);
+    vals[i] = random_word(GF);
+  }
+  crs_cfg_init(&cfg, GF, ord, coeffs, vals, 10);
+
+  double rate = bench_stream(&cfg);
+  crs_cfg_destroy(&cfg);
+  return rate;
+}
+
+// bench_stream for a recurrence of order ord over GF with n_taps nonzero
+// coefficients, spread evenly from a[0].
+static double bench_read_sparse(GF_t *GF, size_t ord, size_t n_taps) {
+  static uint32_t vals[CRS_MAX_ORD];
+  struct crs_tap taps[SPARSE_TAPS];
+  struct crs_cfg cfg;
+
+  for (size_t i = 0; i < ord; ++i) {
+    vals[i] = random_word(GF);
+  }
+  for (size_t k = 0; k < n_taps; ++k) {
+    taps[k].idx = k * ord / n_taps;
+    taps[k].coeff = random_word(GF);
+  }
+  crs_cfg_init_sparse(&cfg, GF, ord, taps, n_taps, vals, 10);
+
+  double rate = bench_stream(&cfg);
+  crs_cfg_destroy(&cfg);
+  return rate;
+}
+
+// bench_read over n lanes of a recurrence of order ord with their own
+// initial values, interleaved or in blocks of block bytes per lane.
+static double bench_lanes(GF_t *GF, size_t ord, size_t n, size_t block) {
+  static uint32_t coeffs[LANES_ORD];
+  static uint32_t vals[CRS_LANES_MAX * LANES_ORD];
+  static uint8_t staging[STAGING_SIZE];
+  static uint8_t user[STAGING_SIZE];
+  struct crs_lanes lanes;
+  struct crs_cfg cfg;
+
+  for (size_t i = 0; i < ord; ++i) {
+    coeffs[i] = random_word(GF);
+  }
+  for (size_t i = 0; i < n * ord; ++i) {
+    vals[i] = random_word(GF);
+  }
+  crs_cfg_init(&cfg, GF, ord, coeffs, vals, 10);
+  crs_lanes_init(&lanes, &cfg, n, block, vals);
+
+  size_t done = 0;
+  double start = now();
+  double elapsed;
+  do {
+    for (size_t i = 0; i < 64; ++i) {
+      crs_lanes_generate(&lanes, staging, STAGING_SIZE);
+      memcpy(user, staging, STAGING_SIZE);
+    }
+    done += 64 * STAGING_SIZE;
+    elapsed = now() - start;
+  } while (elapsed < READ_SECONDS);
+
+  crs_lanes_destroy(&lanes);
+  crs_cfg_destroy(&cfg);
+  sink ^= user[0];
+  return done / elapsed;
+}
+
+// Random coefficients for a recurrence of order ord over GF, with zeros
+// and ones mixed in so that every kind of tap is stepped.
+static void random_coeffs(GF_t *GF, uint32_t *coeffs, size_t ord) {
+  for (size_t i = 0; i < ord; ++i) {
+    switch (rand() % 4) {
+      case 0:
+        coeffs[i] = 0;
+        break;
+      case 1:
+        coeffs[i] = 1;
+        break;
+      default:
+        coeffs[i] = random_word(GF);
+    }
+  }
+  coeffs[0] = random_word(GF);
+}
+
+// Sizes of successive calls in the checks of generated output, so that
+// calls end inside steps, frames and SIMD sections.
+static const size_t check_calls[] = {1, 3, 4096, 333, 5000, 2};
+
+#define CHECK_CALLS (sizeof(check_calls) / sizeof(check_calls[0]))
+
+// Write the next len bytes of the recurrence of cfg to out, one step at a
+// time with GF_packed_mul, from the window vals of ord values.
+static void reference_stream(struct crs_cfg *cfg, const uint32_t *coeffs, uint32_t *vals,
+                             uint8_t *out, size_t len) {
+  size_t ord = cfg->ord;
+  uint32_t v;
+
+  for (size_t i = 0; i < len; i += cfg->width) {
+    v = cfg->cnst;
+    for (size_t k = 0; k < ord; ++k) {
+      v ^= GF_packed_mul(cfg->GF, coeffs[k], vals[k]);
+    }
+    memmove(vals, vals + 1, (ord - 1) * sizeof(*vals));
+    vals[ord - 1] = v;
+    for (size_t j = 0; j < cfg->width && i + j < len; ++j) {
+      out[i + j] = v >> (8 * j);
+    }
+  }
+}
+
+// Check crs_generate, by the block engine or by single steps, against
+// a plain evaluation of the recurrence.
+static void check_stream(const char *name, GF_t *GF, size_t ord) {
+  static uint32_t coeffs[CRS_MAX_ORD];
+  static uint32_t vals[CRS_MAX_ORD];
+  static uint8_t out[16384], ref[16384];
+  struct crs_cfg cfg;
+  struct crs crs;
+  size_t len = 0;
+
+  random_coeffs(GF, coeffs, ord);
+  for (size_t i = 0; i < ord; ++i) {
+    vals[i] = random_word(GF);
+  }
+  crs_cfg_init(&cfg, GF, ord, coeffs, vals, 10);
+  crs_init(&crs);
+  crs_seed(&crs, &cfg);
+
+  for (size_t i = 0; len + check_calls[i % CHECK_CALLS] <= sizeof(out); ++i) {
+    crs_generate(&crs, out + len, check_calls[i % CHECK_CALLS]);
+    len += check_calls[i % CHECK_CALLS];
+  }
+  reference_stream(&cfg, coeffs, vals, ref, len);
+  if (memcmp(out, ref, len)) {
+    fail("crs_generate, %s ord %zu", name, ord);
+  }
+
+  crs_destroy(&crs);
+  crs_cfg_destroy(&cfg);
+}
+
+// Check that n lanes of a recurrence of order ord, in blocks of block bytes
+// or interleaved if block is 0, give the output of n separate generators
+// seeded with the initial values of each lane.
+static void check_lanes(const char *name, GF_t *GF, size_t ord, size_t n, size_t block) {
+  static uint32_t coeffs[LANES_ORD];
+  static uint32_t vals[CRS_LANES_MAX * LANES_ORD];
+  static uint8_t out[16384], ref[16384];
+  size_t w = GF->I->deg / 8;
+  size_t per_lane = block ? block : w;
+  size_t frame = n * per_lane;
+  size_t len = 0;
+  struct crs_lanes lanes;
+  struct crs_cfg cfg;
+  struct crs crs;
+
+  random_coeffs(GF, coeffs, ord);
+  for (size_t i = 0; i < n * ord; ++i) {
+    vals[i] = random_word(GF);
+  }
+  crs_cfg_init(&cfg, GF, ord, coeffs, vals, 10);
+  crs_lanes_init(&lanes, &cfg, n, block, vals);
+  for (size_t i = 0; len + check_calls[i % CHECK_CALLS] <= sizeof(out); ++i) {
+    crs_lanes_generate(&lanes, out + len, check_calls[i % CHECK_CALLS]);
+    len += check_calls[i % CHECK_CALLS];
+  }
+  crs_lanes_destroy(&lanes);
+  crs_cfg_destroy(&cfg);
+
+  // Lane l gives bytes off .. off + per_lane of every frame.
+  for (size_t l = 0; l < n; ++l) {
+    crs_cfg_init(&cfg, GF, ord, coeffs, vals + l * ord, 10);
+    crs_init(&crs);
+    crs_seed(&crs, &cfg);
+    for (size_t off = l * per_lane; off < len; off += frame) {
+      crs_generate(&crs, ref + off, (len - off < per_lane) ? len - off : per_lane);
+    }
+    crs_destroy(&crs);
+    crs_cfg_destroy(&cfg);
+  }
+
+  if (memcmp(out, ref, len)) {
+    fail("crs_lanes_generate, %s ord %zu, %zu lanes, block %zu", name, ord, n, block);
+  }
+}
+
+// Check Karatsuba products against schoolbook ones over GF(p).
+static void check_karatsuba(uint8_t p) {
+  // Products of the last ones are of degree above 255.
+  static const uint8_t degs[] = {0, 1, 15, 16, 17, 47, 63, 100, 127, 150, 200, 255};
+  size_t saved = poly_karatsuba_min;
+  uint8_t buf[8192];
+  arena_t scratch;
+
+  arena_init(&scratch, buf, sizeof(buf));
+  for (size_t i = 0; i < sizeof(degs) / sizeof(degs[0]); ++i) {
+    for (size_t j = 0; j <= i; ++j) {
+      poly_t *a = random_poly(degs[i], p);
+      poly_t *b = random_poly(degs[j], p);
+      poly_t *ref = poly_create_zero(degs[i] + degs[j] + 1);
+      poly_t *res = poly_create_zero(degs[i] + degs[j] + 1);
+
+      poly_karatsuba_min = SIZE_MAX;
+      poly_mul_scratch(ref, a, b, p, &scratch);
+      // Leading terms are nonzero and p is prime, so the degrees add up.
+      if (ref->deg != degs[i] + degs[j]) {
+        fail("Product over GF(%u) of degrees %u and %u has degree %u", p, degs[i], degs[j],
+             ref->deg);
+      }
+      for (size_t k = 0; k < sizeof(karatsuba_mins) / sizeof(karatsuba_mins[0]); ++k) {
+        poly_karatsuba_min = karatsuba_mins[k];
+        poly_mul_scratch(res, a, b, p, &scratch);
+        if (!poly_eq(res, ref)) {
+          fail("Karatsuba product over GF(%u), degrees %u and %u, min %zu", p, degs[i],
+               degs[j], karatsuba_mins[k]);
+        }
+      }
+
+      poly_destroy(a);
+      poly_destroy(b);
+      poly_destroy(ref);
+      poly_destroy(res);
+    }
+  }
+  poly_karatsuba_min = saved;
+}
+
+static bool is_one(GF_elem_t *a) {
+  if (a->GF->packed) {
+    return a->word == 1;
+  }
+  for (size_t i = 1; i <= a->poly->deg; ++i) {
+    if (a->poly->coeff[i]) {
+      return false;
+    }
+  }
+  return a->poly->coeff[0] == 1;
+}
+
+// Check a * a^-1 = 1 for GF_elem_get_inverse and GF_elem_batch_inverse.
+static void check_inverse(const char *name, GF_t *GF) {
+  GF_elem_t *a = GF_elem_array_create(GF, BATCH);
+  GF_elem_t *inv = GF_elem_array_create(GF, BATCH);
+  GF_elem_t *prod = GF_elem_get_neutral(GF);
+  GF_elem_t *x, *y;
+
+  for (size_t i = 0; i < BATCH; ++i) {
+    x = random_elem(GF);
+    GF_elem_set(&a[i], x);
+    GF_elem_destroy(x);
+  }
+
+  for (size_t i = 0; i < BATCH; ++i) {
+    y = GF_elem_get_inverse(&a[i]);
+    GF_elem_prod(prod, &a[i], y);
+    GF_elem_destroy(y);
+    if (!is_one(prod)) {
+      fail("GF_elem_get_inverse over %s", name);
+      break;
+    }
+  }
+
+  GF_elem_batch_inverse(inv, a, BATCH);
+  for (size_t i = 0; i < BATCH; ++i) {
+    GF_elem_prod(prod, &a[i], &inv[i]);
+    if (!is_one(prod)) {
+      fail("GF_elem_batch_inverse over %s", name);
+      break;
+    }
+  }
+
+  GF_elem_array_destroy(a);
+  GF_elem_array_destroy(inv);
+  GF_elem_destroy(prod);
+}
+
+// Bytes compared after each position of check_seek.
+#define SEEK_CHECK_LEN 64
+
+// Check that crs_seek to pos then generating gives the bytes from pos on of
+// the stream stepped from the start, for a recurrence of order ord over GF
+// with n_taps random nonzero coefficients, or all of them if n_taps is 0.
+static void check_seek(const char *name, GF_t *GF, size_t ord, size_t n_taps) {
+  static uint32_t vals[CRS_MAX_ORD];
+  static struct crs_tap taps[CRS_MAX_ORD];
+  static uint8_t ref[12345 + 1 + SEEK_CHECK_LEN];
+  uint8_t out[SEEK_CHECK_LEN];
+  struct crs_cfg cfg;
+  struct crs crs;
+  size_t w = GF->I->deg / 8;
+  const uint64_t pos[] = {0, 1, w - 1, w, w + 1, 4095, 12345, 7};
+
+  if (!n_taps) {
+    n_taps = ord;
+  }
+  for (size_t i = 0; i < ord; ++i) {
+    vals[i] = random_word(GF);
+  }
+  for (size_t k = 0; k < n_taps; ++k) {
+    taps[k].idx = k * ord / n_taps;
+    taps[k].coeff = random_word(GF);
+  }
+  crs_cfg_init_sparse(&cfg, GF, ord, taps, n_taps, vals, 10);
+
+  crs_init(&crs);
+  crs_seed(&crs, &cfg);
+  crs_generate(&crs, ref, sizeof(ref));
+
+  // Backward and forward seeks, on the same generator.
+  for (size_t i = 0; i < sizeof(pos) / sizeof(pos[0]); ++i) {
+    crs_seek(&crs, pos[i]);
+    crs_generate(&crs, out, sizeof(out));
+    if (memcmp(out, ref + pos[i], sizeof(out))) {
+      fail("crs_seek to %llu, %s ord %zu with %zu taps", (unsigned long long)pos[i], name,
+           ord, n_taps);
+    }
+  }
+
+  crs_destroy(&crs);
+  crs_cfg_destroy(&cfg);
+}
+
+int main(void) {
+  static const size_t ords[] = {3, 16, 80};
+  static const size_t lane_counts[] = {1, 4, 64, 256};
+  static const size_t sparse_ords[] = {80, 1279, CRS_MAX_ORD};
+  // Orders either side of the limit of the block engine, and lane counts
+  // that do not fill a vector.
+  static const size_t check_ords[] = {1, 3, 16, 80, CRS_BLOCK_MAX_ORD + 1};
+  static const size_t check_lane_counts[] = {1, 3, 64, 100};
+  double odd_mod[ODD_FIELDS][3];
+  double odd_tab[ODD_FIELDS][3];
+  double odd_elem[ODD_FIELDS][2];
+
+  srand(1);
+  // Every coefficient is reduced with % until the tables are built.
+  for (size_t i = 0; i < ODD_FIELDS; ++i) {
+    bench_odd(i, odd_mod[i]);
+  }
+  GF_init_tables();
+
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    for (size_t j = 0; j < sizeof(ords) / sizeof(ords[0]); ++j) {
+      check_seek(fields[i].name, fields[i].GF, ords[j], 0);
+    }
+    check_seek(fields[i].name, fields[i].GF, 1, 0);
+    check_seek(fields[i].name, fields[i].GF, 1279, SPARSE_TAPS);
+  }
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    for (size_t j = 0; j < sizeof(check_ords) / sizeof(check_ords[0]); ++j) {
+      check_stream(fields[i].name, fields[i].GF, check_ords[j]);
+    }
+    for (size_t j = 0; j < sizeof(check_lane_counts) / sizeof(check_lane_counts[0]); ++j) {
+      check_lanes(fields[i].name, fields[i].GF, LANES_ORD, check_lane_counts[j], 0);
+      check_lanes(fields[i].name, fields[i].GF, LANES_ORD, check_lane_counts[j], LANES_BLOCK);
+    }
+    check_inverse(fields[i].name, fields[i].GF);
+  }
+  for (size_t i = 0; i < ODD_FIELDS; ++i) {
+    poly_t I = {.deg = odd_fields[i].deg, .coeff = odd_fields[i].coeff};
+    GF_t *GF = GF_init_field(odd_fields[i].p, I);
+
+    check_inverse(odd_fields[i].name, GF);
+    check_karatsuba(odd_fields[i].p);
+    GF_destroy_field(GF);
+  }
+
+  for (size_t i = 0; i < ODD_FIELDS; ++i) {
+    bench_odd(i, odd_tab[i]);
+    bench_odd_elem(i, odd_elem[i]);
+  }
+
+  printf("%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "ns/op", "sum", "prod", "inverse",
+         "batch_inv", "dot", "poly_mul", "poly_div", "fpowm");
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    GF_t *GF = fields[i].GF;
+    printf("%-8s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", fields[i].name,
+           bench_sum(GF), bench_prod(GF), bench_inverse(GF), bench_batch_inverse(GF),
+           bench_dot(GF), bench_poly_mul(GF), bench_poly_div(GF), bench_poly_fpowm(GF));
+  }
+
+  printf("\n%-8s %10s %10s %10s %10s %10s %10s %10s %10s\n", "ns/op", "mul %", "mul tab",
+         "div %", "div tab", "inv %", "inv tab", "from_array", "cpy");
+  for (size_t i = 0; i < ODD_FIELDS; ++i) {
+    printf("%-8s", odd_fields[i].name);
+    for (size_t j = 0; j < 3; ++j) {
+      printf(" %10.1f %10.1f", odd_mod[i][j], odd_tab[i][j]);
+    }
+    printf(" %10.1f %10.1f\n", odd_elem[i][0], odd_elem[i][1]);
+  }
+
+  printf("\n%-8s %10s", "GF3 deg", "schoolbook");
+  for (size_t j = 0; j < sizeof(karatsuba_mins) / sizeof(karatsuba_mins[0]); ++j) {
+    printf("     kara %-2zu", karatsuba_mins[j]);
+  }
+  printf("\n");
+  for (size_t i = 0; i < sizeof(karatsuba_degs) / sizeof(karatsuba_degs[0]); ++i) {
+    printf("%-8zu %10.1f", karatsuba_degs[i], bench_karatsuba(karatsuba_degs[i], 0));
+    for (size_t j = 0; j < sizeof(karatsuba_mins) / sizeof(karatsuba_mins[0]); ++j) {
+      printf(" %10.1f", bench_karatsuba(karatsuba_degs[i], karatsuba_mins[j]));
+    }
+    printf("\n");
+  }
+
+  printf("\n%-8s", "MB/s");
+  for (size_t j = 0; j < sizeof(ords) / sizeof(ords[0]); ++j) {
+    printf("     ord %-3zu", ords[j]);
+  }
+  printf("\n");
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    printf("%-8s", fields[i].name);
+    for (size_t j = 0; j < sizeof(ords) / sizeof(ords[0]); ++j) {
+      printf(" %11.1f", bench_read(fields[i].GF, ords[j]) / 1e6);
+    }
+    printf("\n");
+  }
+
+  printf("\n%-8s", "MB/s");
+  for (size_t j = 0; j < sizeof(sparse_ords) / sizeof(sparse_ords[0]); ++j) {
+    printf(" %d taps/%-4zu", SPARSE_TAPS, sparse_ords[j]);
+  }
+  printf("\n");
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    printf("%-8s", fields[i].name);
+    for (size_t j = 0; j < sizeof(sparse_ords) / sizeof(sparse_ords[0]); ++j) {
+      printf(" %11.1f", bench_read_sparse(fields[i].GF, sparse_ords[j], SPARSE_TAPS) / 1e6);
+    }
+    printf("\n");
+  }
+
+  printf("\n%-8s", "MB/s");
+  for (size_t j = 0; j < sizeof(lane_counts) / sizeof(lane_counts[0]); ++j) {
+    printf(" %4zu lanes ", lane_counts[j]);
+  }
+  printf(" 256 x %-3d B\n", LANES_BLOCK);
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    printf("%-8s", fields[i].name);
+    for (size_t j = 0; j < sizeof(lane_counts) / sizeof(lane_counts[0]); ++j) {
+      printf(" %11.1f", bench_lanes(fields[i].GF, LANES_ORD, lane_counts[j], 0) / 1e6);
+    }
+    printf(" %11.1f\n", bench_lanes(fields[i].GF, LANES_ORD, 256, LANES_BLOCK) / 1e6);
+  }
+
+  if (failures) {
+    fprintf(stderr, "%d self-checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+/* Userspace stand-in for <asm/cpufeature.h>. */
+
+#define X86_FEATURE_PCLMULQDQ "pclmul"
+#define X86_FEATURE_SSSE3 "ssse3"
+#define X86_FEATURE_AVX2 "avx2"
+
+#define boot_cpu_has(feature) __builtin_cpu_supports(feature)
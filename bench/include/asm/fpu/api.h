@@ -0,0 +1,7 @@
+#pragma once
+
+/* Userspace stand-in for <asm/fpu/api.h>. The arithmetic is built with
+   -mgeneral-regs-only, so there is no compiler state to save. */
+
+static inline void kernel_fpu_begin(void) {}
+static inline void kernel_fpu_end(void) {}
@@ -0,0 +1,9 @@
+#pragma once
+
+/* Userspace stand-in for <asm/simd.h>. */
+
+#include <stdbool.h>
+
+static inline bool may_use_simd(void) {
+  return true;
+}
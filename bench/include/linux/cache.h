@@ -0,0 +1,8 @@
+#pragma once
+
+/* Userspace stand-in for <linux/cache.h>. */
+
+#define L1_CACHE_BYTES 64
+
+#define __aligned(x) __attribute__((aligned(x)))
+#define ____cacheline_aligned __aligned(L1_CACHE_BYTES)
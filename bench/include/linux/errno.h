@@ -0,0 +1,5 @@
+#pragma once
+
+/* Userspace stand-in for <linux/errno.h>. */
+
+#include <asm/errno.h>
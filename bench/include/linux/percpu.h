@@ -0,0 +1,8 @@
+#pragma once
+
+/* Userspace stand-in for <linux/percpu.h>: a single CPU. */
+
+#define DEFINE_PER_CPU(type, name) __typeof__(type) name
+
+#define this_cpu_read(var) (var)
+#define this_cpu_write(var, val) ((var) = (val))
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Userspace stand-in for <linux/sched.h>. */
+
+static inline void cond_resched(void)
+{
+}
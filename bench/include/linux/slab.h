@@ -0,0 +1,25 @@
+#pragma once
+
+/* Userspace stand-in for <linux/slab.h>. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GFP_KERNEL 0
+
+#define kmalloc(size, flags) malloc(size)
+#define kcalloc(nmemb, size, flags) calloc(nmemb, size)
+#define kfree(ptr) free((void *)(ptr))
+
+/* Large kmalloc allocations come from naturally aligned power-of-two caches
+   and vmalloc from whole pages, so the kernel's kvmalloc of a table such as
+   struct crs_block is at least cache-line aligned. */
+static inline void *kvmalloc(size_t size, int flags) {
+  void *ptr;
+  return posix_memalign(&ptr, 64, size ? size : 1) ? NULL : ptr;
+}
+
+#define kvmalloc_array(n, size, flags) \
+  ((size) && (n) > SIZE_MAX / (size) ? NULL : kvmalloc((n) * (size), flags))
+#define kvfree(ptr) free((void *)(ptr))
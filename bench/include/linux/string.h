@@ -0,0 +1,5 @@
+#pragma once
+
+/* Userspace stand-in for <linux/string.h>. */
+
+#include <string.h>
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Userspace stand-in for <linux/types.h>. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
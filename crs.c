@@ -0,0 +1,810 @@
+#include "crs.h"
+
+#include <linux/errno.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/cpufeature.h>
+#endif
+
+#include "GF.h"
+#include "GF2w.h"
+
+/* Fill jump_taps and jump_base of a configuration. */
+static void crs_cfg_init_jump(struct crs_cfg *cfg)
+{
+        struct crs_tap *q = cfg->jump_taps;
+        uint32_t idx, a, v;
+        size_t k, n;
+
+        /* In characteristic 2, Q(x) = (x + 1) P(x) with
+           P(x) = x^ord + a[ord - 1] x^(ord - 1) + ... + a[0],
+           so tap a[i] of P adds a[i] to q[i] and q[i + 1]. Subtraction is
+           addition. The leading term of P comes last and its x^(ord + 1)
+           is left out. */
+        n = 0;
+        for (k = 0; k <= cfg->n_taps; ++k) {
+                idx = (k < cfg->n_taps) ? cfg->taps[k].idx : cfg->ord;
+                a = (k < cfg->n_taps) ? cfg->taps[k].coeff : 1;
+                if (n && q[n - 1].idx == idx) {
+                        q[n - 1].coeff ^= a;
+                        if (!q[n - 1].coeff) {
+                                --n;
+                        }
+                } else {
+                        q[n].idx = idx;
+                        q[n++].coeff = a;
+                }
+                if (idx < cfg->ord) {
+                        q[n].idx = idx + 1;
+                        q[n++].coeff = a;
+                }
+        }
+        cfg->n_jump = n;
+
+        /* v[ord] is the first value the recurrence produces. */
+        memcpy(cfg->jump_base, cfg->vals, cfg->ord * sizeof(*cfg->vals));
+        v = cfg->cnst;
+        for (k = 0; k < cfg->n_taps; ++k) {
+                v ^= GF_packed_mul(cfg->GF, cfg->taps[k].coeff, cfg->vals[cfg->taps[k].idx]);
+        }
+        cfg->jump_base[cfg->ord] = v;
+}
+
+/* Fill the block transition of a configuration. */
+static void crs_cfg_init_block(struct crs_cfg *cfg)
+{
+        struct crs_block *blk = cfg->blk;
+        size_t t, k, j, col;
+        uint32_t a, cnst;
+
+        /* Value t + i after the start of the window is either w[t + i] or
+           output t + i - ord, whose row of M is already known. Build M
+           column-major in lo, then split it. */
+        memset(blk->lo, 0, sizeof(blk->lo));
+        for (t = 0; t < CRS_BLOCK; ++t) {
+                cnst = cfg->cnst;
+                for (k = 0; k < cfg->n_taps; ++k) {
+                        a = cfg->taps[k].coeff;
+                        j = t + cfg->taps[k].idx;
+                        if (j < cfg->ord) {
+                                blk->lo[j][t] ^= a;
+                                continue;
+                        }
+                        for (col = 0; col < cfg->ord; ++col) {
+                                blk->lo[col][t] ^= GF_packed_mul(cfg->GF, a, blk->lo[col][j - cfg->ord]);
+                        }
+                        cnst ^= GF_packed_mul(cfg->GF, a, blk->cnst[j - cfg->ord]);
+                }
+                blk->cnst[t] = cnst;
+        }
+
+        for (col = 0; col < cfg->ord; ++col) {
+                for (t = 0; t < CRS_BLOCK; ++t) {
+                        blk->hi[col][t] = blk->lo[col][t] >> 4;
+                        blk->lo[col][t] &= 0x0f;
+                }
+        }
+}
+
+/* Allocate and fill the single step tables of a configuration over GF2_8. */
+static int crs_cfg_init_step(struct crs_cfg *cfg)
+{
+        uint32_t a;
+        size_t k, x;
+
+        cfg->n_one = 0;
+        for (k = 0; k < cfg->n_taps; ++k) {
+                cfg->n_one += cfg->taps[k].coeff == 1;
+        }
+        cfg->n_mul = cfg->n_taps - cfg->n_one;
+        if (!cfg->n_taps) {
+                return 0;
+        }
+
+        cfg->one_idx = kvmalloc_array(cfg->n_taps, sizeof(*cfg->one_idx), GFP_KERNEL);
+        if (!cfg->one_idx) {
+                return -ENOMEM;
+        }
+        cfg->mul_idx = cfg->one_idx + cfg->n_one;
+        if (cfg->n_mul) {
+                cfg->mul_tbl = kvmalloc_array(cfg->n_mul, sizeof(*cfg->mul_tbl), GFP_KERNEL);
+                if (!cfg->mul_tbl) {
+                        return -ENOMEM;
+                }
+        }
+
+        cfg->n_one = 0;
+        cfg->n_mul = 0;
+        for (k = 0; k < cfg->n_taps; ++k) {
+                a = cfg->taps[k].coeff;
+                if (a == 1) {
+                        cfg->one_idx[cfg->n_one++] = cfg->taps[k].idx;
+                        continue;
+                }
+                for (x = 0; x < 256; ++x) {
+                        cfg->mul_tbl[cfg->n_mul][x] = GF_packed_mul(cfg->GF, a, x);
+                }
+                cfg->mul_idx[cfg->n_mul++] = cfg->taps[k].idx;
+        }
+
+        return 0;
+}
+
+/* Allocate and fill the single step tables of a configuration over GF2_16. */
+static int crs_cfg_init_step16(struct crs_cfg *cfg)
+{
+        uint32_t a;
+        size_t k, x;
+
+        if (!cfg->n_taps) {
+                return 0;
+        }
+        cfg->mul16_tbl = kvmalloc_array(cfg->n_taps, sizeof(*cfg->mul16_tbl), GFP_KERNEL);
+        if (!cfg->mul16_tbl) {
+                return -ENOMEM;
+        }
+
+        /* Multiplication by a is linear, so a * w is the sum of the
+           products of the two bytes of w. */
+        for (k = 0; k < cfg->n_taps; ++k) {
+                a = cfg->taps[k].coeff;
+                for (x = 0; x < 256; ++x) {
+                        cfg->mul16_tbl[k][0][x] = GF_packed_mul(cfg->GF, a, x);
+                        cfg->mul16_tbl[k][1][x] = GF_packed_mul(cfg->GF, a, x << 8);
+                }
+        }
+
+        return 0;
+}
+
+/* Return true if x is the packed form of an element of GF. */
+static bool crs_fits(GF_t *GF, uint32_t x)
+{
+        return GF->I->deg == 32 || !(x >> GF->I->deg);
+}
+
+/* Check the field, the initial values and the constant, and allocate the
+   taps and initial values of a configuration. The taps are left to the caller. */
+static int crs_cfg_alloc(struct crs_cfg *cfg, GF_t *GF, size_t ord, size_t n_taps,
+                         const uint32_t *vals, uint32_t cnst)
+{
+        size_t i;
+
+        memset(cfg, 0, sizeof(*cfg));
+
+        if (!ord || ord > CRS_MAX_ORD) {
+                return -EINVAL;
+        }
+
+        if (!GF->packed || GF->p != 2 || GF->I->deg % 8) {
+                return -EINVAL;
+        }
+
+        if (!crs_fits(GF, cnst)) {
+                return -EINVAL;
+        }
+        for (i = 0; i < ord; ++i) {
+                if (!crs_fits(GF, vals[i])) {
+                        return -EINVAL;
+                }
+        }
+
+        cfg->GF = GF;
+        cfg->width = GF->I->deg / 8;
+        cfg->ord = ord;
+        cfg->cnst = cnst;
+        cfg->n_taps = n_taps;
+
+        cfg->vals = kvmalloc_array(ord, sizeof(*cfg->vals), GFP_KERNEL);
+        if (!cfg->vals) {
+                return -ENOMEM;
+        }
+        memcpy(cfg->vals, vals, ord * sizeof(*vals));
+
+        if (n_taps) {
+                cfg->taps = kvmalloc_array(n_taps, sizeof(*cfg->taps), GFP_KERNEL);
+                if (!cfg->taps) {
+                        return -ENOMEM;
+                }
+        }
+
+        return 0;
+}
+
+/* Build the tables of a configuration from its taps. */
+static int crs_cfg_build(struct crs_cfg *cfg)
+{
+        cfg->jump_taps = kvmalloc_array(2 * cfg->n_taps + 1, sizeof(*cfg->jump_taps), GFP_KERNEL);
+        cfg->jump_base = kvmalloc_array(cfg->ord + 1, sizeof(*cfg->jump_base), GFP_KERNEL);
+        if (!cfg->jump_taps || !cfg->jump_base) {
+                return -ENOMEM;
+        }
+        crs_cfg_init_jump(cfg);
+
+        if (cfg->GF == &GF2_16) {
+                return crs_cfg_init_step16(cfg);
+        }
+        if (cfg->GF != &GF2_8) {
+                return 0;
+        }
+        if (cfg->ord <= CRS_BLOCK_MAX_ORD) {
+                cfg->blk = kvmalloc(sizeof(*cfg->blk), GFP_KERNEL);
+                if (!cfg->blk) {
+                        return -ENOMEM;
+                }
+                crs_cfg_init_block(cfg);
+        }
+        return crs_cfg_init_step(cfg);
+}
+
+int crs_cfg_init(struct crs_cfg *cfg, GF_t *GF, size_t ord, const uint32_t *coeffs,
+                 const uint32_t *vals, uint32_t cnst)
+{
+        size_t i;
+        int ret;
+
+        ret = crs_cfg_alloc(cfg, GF, ord, ord, vals, cnst);
+        if (ret) {
+                goto err;
+        }
+
+        /* Only the nonzero coefficients become taps. */
+        cfg->n_taps = 0;
+        for (i = 0; i < ord; ++i) {
+                if (!crs_fits(GF, coeffs[i])) {
+                        ret = -EINVAL;
+                        goto err;
+                }
+                if (coeffs[i]) {
+                        cfg->taps[cfg->n_taps].idx = i;
+                        cfg->taps[cfg->n_taps++].coeff = coeffs[i];
+                }
+        }
+
+        ret = crs_cfg_build(cfg);
+        if (ret) {
+                goto err;
+        }
+        return 0;
+
+err:
+        crs_cfg_destroy(cfg);
+        return ret;
+}
+
+int crs_cfg_init_sparse(struct crs_cfg *cfg, GF_t *GF, size_t ord, const struct crs_tap *taps,
+                        size_t n_taps, const uint32_t *vals, uint32_t cnst)
+{
+        size_t k;
+        int ret;
+
+        ret = crs_cfg_alloc(cfg, GF, ord, n_taps, vals, cnst);
+        if (ret) {
+                goto err;
+        }
+
+        /* Zero coefficients are dropped as well. */
+        cfg->n_taps = 0;
+        for (k = 0; k < n_taps; ++k) {
+                if (taps[k].idx >= ord || (k && taps[k].idx <= taps[k - 1].idx) ||
+                    !crs_fits(GF, taps[k].coeff)) {
+                        ret = -EINVAL;
+                        goto err;
+                }
+                if (taps[k].coeff) {
+                        cfg->taps[cfg->n_taps++] = taps[k];
+                }
+        }
+
+        ret = crs_cfg_build(cfg);
+        if (ret) {
+                goto err;
+        }
+        return 0;
+
+err:
+        crs_cfg_destroy(cfg);
+        return ret;
+}
+
+void crs_cfg_destroy(struct crs_cfg *cfg)
+{
+        kvfree(cfg->taps);
+        kvfree(cfg->vals);
+        kvfree(cfg->jump_taps);
+        kvfree(cfg->jump_base);
+        kvfree(cfg->blk);
+        kvfree(cfg->one_idx);
+        kvfree(cfg->mul_tbl);
+        kvfree(cfg->mul16_tbl);
+        memset(cfg, 0, sizeof(*cfg));
+}
+
+void crs_init(struct crs *crs)
+{
+        memset(crs, 0, sizeof(*crs));
+}
+
+void crs_destroy(struct crs *crs)
+{
+        kvfree(crs->vals);
+        crs_init(crs);
+}
+
+/* Make room in a generator for configurations of order ord. */
+static int crs_reserve(struct crs *crs, size_t ord)
+{
+        uint32_t *buf;
+
+        if (ord <= crs->cap) {
+                return 0;
+        }
+
+        /* The window and the seek scratch share one allocation. */
+        buf = kvmalloc_array(2 * ord + 3 * (ord + 1), sizeof(*buf), GFP_KERNEL);
+        if (!buf) {
+                return -ENOMEM;
+        }
+
+        kvfree(crs->vals);
+        crs->vals = buf;
+        crs->jump_res = buf + 2 * ord;
+        crs->jump_tmp = crs->jump_res + ord + 1;
+        crs->cap = ord;
+
+        return 0;
+}
+
+int crs_seed(struct crs *crs, struct crs_cfg *cfg)
+{
+        int ret;
+
+        ret = crs_reserve(crs, cfg->ord);
+        if (ret) {
+                return ret;
+        }
+
+        crs->cfg = cfg;
+        crs->pos = 0;
+        crs->head = 0;
+        crs->part_len = 0;
+        memcpy(crs->vals, cfg->vals, cfg->ord * sizeof(*cfg->vals));
+        memcpy(crs->vals + cfg->ord, cfg->vals, cfg->ord * sizeof(*cfg->vals));
+
+        return 0;
+}
+
+/* Append x to the window, dropping the oldest value. */
+static void crs_push(struct crs *crs, uint32_t x)
+{
+        crs->vals[crs->head] = x;
+        crs->vals[crs->head + crs->cfg->ord] = x;
+        crs->head = (crs->head + 1 == crs->cfg->ord) ? 0 : crs->head + 1;
+}
+
+/* crs_next over GF2_8: one table lookup per tap. */
+static uint32_t crs_next_step(struct crs *crs)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        const uint32_t *window = crs->vals + crs->head;
+        uint8_t x = cfg->cnst;
+        size_t k;
+
+        for (k = 0; k < cfg->n_one; ++k) {
+                x ^= window[cfg->one_idx[k]];
+        }
+        for (k = 0; k < cfg->n_mul; ++k) {
+                x ^= cfg->mul_tbl[k][window[cfg->mul_idx[k]]];
+        }
+
+        crs_push(crs, x);
+        return x;
+}
+
+/* crs_next over GF2_16: two table lookups per tap. */
+static uint32_t crs_next_step16(struct crs *crs)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        const uint32_t *window = crs->vals + crs->head;
+        uint16_t x = cfg->cnst;
+        uint32_t w;
+        size_t k;
+
+        for (k = 0; k < cfg->n_taps; ++k) {
+                w = window[cfg->taps[k].idx];
+                x ^= cfg->mul16_tbl[k][0][w & 0xff] ^ cfg->mul16_tbl[k][1][w >> 8];
+        }
+
+        crs_push(crs, x);
+        return x;
+}
+
+/* Advance the CRS by one step and return the new value. */
+static uint32_t crs_next(struct crs *crs)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        const uint32_t *window = crs->vals + crs->head;
+        uint64_t acc;
+        uint32_t x;
+        size_t k;
+
+        if (cfg->GF == &GF2_8) {
+                return crs_next_step(crs);
+        }
+        if (cfg->mul16_tbl) {
+                return crs_next_step16(crs);
+        }
+
+        /* Sum the carry-less products and reduce once, as GF_packed_dot. */
+        acc = cfg->cnst;
+        for (k = 0; k < cfg->n_taps; ++k) {
+                acc ^= GF2w_clmul(cfg->taps[k].coeff, window[cfg->taps[k].idx]);
+        }
+        x = GF2w_reduce(acc, cfg->GF->I->deg, cfg->GF->Iw);
+
+        crs_push(crs, x);
+        return x;
+}
+
+/* Store the width low bytes of x, least significant first. */
+static void crs_put(uint8_t *buf, uint32_t x, size_t width)
+{
+        size_t k;
+
+        for (k = 0; k < width; ++k) {
+                buf[k] = x >> (8 * k);
+        }
+}
+
+/* Output what is left of a partially output step. Returns the number of bytes written. */
+static size_t crs_drain(struct crs *crs, uint8_t *buf, size_t len)
+{
+        size_t i;
+
+        for (i = 0; i < len && crs->part_len; ++i, --crs->part_len) {
+                buf[i] = crs->part[crs->cfg->width - crs->part_len];
+        }
+
+        return i;
+}
+
+#ifdef CONFIG_X86_64
+/* One block of outputs with 32-byte shuffles. The kernel is built
+   without SSE, so the compiler leaves the vector registers alone
+   between these statements. */
+static void crs_block_avx2(struct crs_cfg *cfg, const uint8_t *win, uint8_t *out)
+{
+        const uint8_t *tbl;
+        size_t i;
+
+        asm volatile("vmovdqa %0, %%ymm7" : : "m" (cfg->blk->cnst[0]));
+        for (i = 0; i < cfg->ord; ++i) {
+                tbl = GF2_8_nibble[win[i]];
+                asm volatile("vbroadcasti128 %0, %%ymm0\n\t"
+                             "vbroadcasti128 %1, %%ymm1\n\t"
+                             "vpshufb %2, %%ymm0, %%ymm0\n\t"
+                             "vpshufb %3, %%ymm1, %%ymm1\n\t"
+                             "vpxor %%ymm0, %%ymm7, %%ymm7\n\t"
+                             "vpxor %%ymm1, %%ymm7, %%ymm7"
+                             :
+                             : "m" (tbl[0]), "m" (tbl[16]),
+                               "m" (cfg->blk->lo[i][0]), "m" (cfg->blk->hi[i][0]));
+        }
+        asm volatile("vmovdqu %%ymm7, %0\n\t"
+                     "vzeroupper"
+                     : "=m" (out[0])
+                     :
+                     : "memory");
+}
+
+/* Same as crs_block_avx2, as two 16-byte halves. */
+static void crs_block_ssse3(struct crs_cfg *cfg, const uint8_t *win, uint8_t *out)
+{
+        const uint8_t *tbl;
+        size_t i;
+
+        asm volatile("movdqa %0, %%xmm6\n\t"
+                     "movdqa %1, %%xmm7"
+                     :
+                     : "m" (cfg->blk->cnst[0]), "m" (cfg->blk->cnst[16]));
+        for (i = 0; i < cfg->ord; ++i) {
+                tbl = GF2_8_nibble[win[i]];
+                asm volatile("movdqa %0, %%xmm0\n\t"
+                             "movdqa %0, %%xmm2\n\t"
+                             "movdqa %1, %%xmm1\n\t"
+                             "movdqa %1, %%xmm3\n\t"
+                             "pshufb %2, %%xmm0\n\t"
+                             "pshufb %3, %%xmm2\n\t"
+                             "pshufb %4, %%xmm1\n\t"
+                             "pshufb %5, %%xmm3\n\t"
+                             "pxor %%xmm0, %%xmm6\n\t"
+                             "pxor %%xmm1, %%xmm6\n\t"
+                             "pxor %%xmm2, %%xmm7\n\t"
+                             "pxor %%xmm3, %%xmm7"
+                             :
+                             : "m" (tbl[0]), "m" (tbl[16]),
+                               "m" (cfg->blk->lo[i][0]), "m" (cfg->blk->lo[i][16]),
+                               "m" (cfg->blk->hi[i][0]), "m" (cfg->blk->hi[i][16]));
+        }
+        asm volatile("movdqu %%xmm6, %0\n\t"
+                     "movdqu %%xmm7, %1"
+                     : "=m" (out[0]), "=m" (out[16])
+                     :
+                     : "memory");
+}
+
+/* crs_next over GF2_32 with PCLMULQDQ inline, for SIMD sections. As in
+   crs_block_avx2, xmm7 carries the sum of the products between statements,
+   and the sum is reduced once. */
+static uint32_t crs_next_pclmul(struct crs *crs)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        const uint32_t *window = crs->vals + crs->head;
+        uint64_t mask = ((uint64_t)1 << cfg->GF->I->deg) - 1;
+        uint64_t acc, hi;
+        size_t k;
+
+        asm volatile("movq %0, %%xmm7" : : "r" ((uint64_t)cfg->cnst));
+        for (k = 0; k < cfg->n_taps; ++k) {
+                asm volatile("movd %0, %%xmm0\n\t"
+                             "movd %1, %%xmm1\n\t"
+                             "pclmulqdq $0x00, %%xmm1, %%xmm0\n\t"
+                             "pxor %%xmm0, %%xmm7"
+                             :
+                             : "m" (cfg->taps[k].coeff), "m" (window[cfg->taps[k].idx]));
+        }
+        asm volatile("movq %%xmm7, %0" : "=r" (acc));
+
+        /* x^m = Iw, so fold the bits above x^m back as GF2w_reduce does. */
+        while ((hi = acc >> cfg->GF->I->deg)) {
+                asm volatile("movq %1, %%xmm0\n\t"
+                             "movq %2, %%xmm1\n\t"
+                             "pclmulqdq $0x00, %%xmm1, %%xmm0\n\t"
+                             "movq %%xmm0, %0"
+                             : "=r" (hi)
+                             : "r" (hi), "r" ((uint64_t)cfg->GF->Iw));
+                acc = (acc & mask) ^ hi;
+        }
+
+        crs_push(crs, acc);
+        return acc;
+}
+
+/* Return the single step usable inside a SIMD section. */
+static uint32_t (*crs_next_fn(struct crs_cfg *cfg))(struct crs *)
+{
+        if (cfg->GF == &GF2_32 && boot_cpu_has(X86_FEATURE_PCLMULQDQ)) {
+                return crs_next_pclmul;
+        }
+        return crs_next;
+}
+
+/* Return the block kernel usable inside a SIMD section, or NULL. */
+static void (*crs_block_fn(struct crs_cfg *cfg))(struct crs_cfg *, const uint8_t *, uint8_t *)
+{
+        if (!cfg->blk) {
+                return NULL;
+        }
+        if (boot_cpu_has(X86_FEATURE_AVX2)) {
+                return crs_block_avx2;
+        }
+        if (boot_cpu_has(X86_FEATURE_SSSE3)) {
+                return crs_block_ssse3;
+        }
+        return NULL;
+}
+#else
+static uint32_t (*crs_next_fn(struct crs_cfg *cfg))(struct crs *)
+{
+        return crs_next;
+}
+
+static void (*crs_block_fn(struct crs_cfg *cfg))(struct crs_cfg *, const uint8_t *, uint8_t *)
+{
+        return NULL;
+}
+#endif
+
+/* Fill as many whole blocks of buf as fit in len with the block kernel
+   and return the number of bytes written. */
+static size_t crs_generate_blocks(struct crs *crs, uint8_t *buf, size_t len,
+                                  void (*block)(struct crs_cfg *, const uint8_t *, uint8_t *))
+{
+        struct crs_cfg *cfg = crs->cfg;
+        uint8_t *win = crs->blk_win;
+        size_t i, j;
+
+        if (len < CRS_BLOCK) {
+                return 0;
+        }
+
+        for (j = 0; j < cfg->ord; ++j) {
+                win[j] = crs->vals[crs->head + j];
+        }
+
+        for (i = 0; i + CRS_BLOCK <= len; i += CRS_BLOCK) {
+                block(cfg, win, buf + i);
+                /* Slide the window past the block. */
+                if (CRS_BLOCK >= cfg->ord) {
+                        memcpy(win, buf + i + CRS_BLOCK - cfg->ord, cfg->ord);
+                } else {
+                        memmove(win, win + CRS_BLOCK, cfg->ord - CRS_BLOCK);
+                        memcpy(win + cfg->ord - CRS_BLOCK, buf + i, CRS_BLOCK);
+                }
+        }
+
+        crs->head = 0;
+        for (j = 0; j < cfg->ord; ++j) {
+                crs->vals[j] = win[j];
+                crs->vals[j + cfg->ord] = win[j];
+        }
+
+        return i;
+}
+
+/* crs_generate without the position update, in one SIMD section. */
+static void crs_generate_section(struct crs *crs, uint8_t *buf, size_t len)
+{
+        void (*block)(struct crs_cfg *, const uint8_t *, uint8_t *);
+        uint32_t (*next)(struct crs *) = crs_next;
+        size_t width = crs->cfg->width;
+        size_t i;
+        bool simd;
+
+        i = crs_drain(crs, buf, len);
+
+        /* Pay for the FPU state save once per section. */
+        simd = GF2w_simd_begin();
+        if (simd) {
+                next = crs_next_fn(crs->cfg);
+                block = crs_block_fn(crs->cfg);
+                if (block) {
+                        i += crs_generate_blocks(crs, buf + i, len - i, block);
+                }
+        }
+        for (; i + width <= len; i += width) {
+                crs_put(buf + i, next(crs), width);
+        }
+        if (i < len) {
+                crs_put(crs->part, next(crs), width);
+                crs->part_len = width;
+                crs_drain(crs, buf + i, len - i);
+        }
+        if (simd) {
+                GF2w_simd_end();
+        }
+}
+
+void crs_generate(struct crs *crs, uint8_t *buf, size_t len)
+{
+        size_t i, chunk;
+
+        for (i = 0; i < len; i += chunk) {
+                chunk = (len - i < CRS_SIMD_CHUNK) ? len - i : CRS_SIMD_CHUNK;
+                crs_generate_section(crs, buf + i, chunk);
+        }
+        crs->pos += len;
+}
+
+/* Set r = x * r mod Q(x), where r has len coefficients. */
+static void crs_jump_shift(struct crs_cfg *cfg, uint32_t *r, size_t len)
+{
+        uint32_t top = r[len - 1];
+        size_t k;
+
+        memmove(r + 1, r, (len - 1) * sizeof(*r));
+        r[0] = 0;
+        if (!top) {
+                return;
+        }
+        for (k = 0; k < cfg->n_jump; ++k) {
+                r[cfg->jump_taps[k].idx] ^= GF_packed_mul(cfg->GF, top, cfg->jump_taps[k].coeff);
+        }
+}
+
+/* Set r = r^2 mod Q(x), where r has len coefficients. */
+static void crs_jump_square(struct crs *crs, uint32_t *r, size_t len)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        uint32_t *t = crs->jump_tmp;
+        uint32_t top;
+        size_t i, k;
+
+        /* In characteristic 2 the cross terms cancel, so the square of
+           r[0] + r[1] x + ... is r[0]^2 + r[1]^2 x^2 + .... */
+        memset(t, 0, (2 * len - 1) * sizeof(*t));
+        for (i = 0; i < len; ++i) {
+                if (r[i]) {
+                        t[2 * i] = GF_packed_mul(cfg->GF, r[i], r[i]);
+                }
+        }
+
+        /* x^(len + j) = x^j (Q(x) - x^len), highest terms first. Only the
+           taps of Q contribute. */
+        for (i = 2 * len - 2; i >= len; --i) {
+                top = t[i];
+                if (!top) {
+                        continue;
+                }
+                for (k = 0; k < cfg->n_jump; ++k) {
+                        t[i - len + cfg->jump_taps[k].idx] ^=
+                                GF_packed_mul(cfg->GF, top, cfg->jump_taps[k].coeff);
+                }
+        }
+
+        memcpy(r, t, len * sizeof(*r));
+}
+
+void crs_seek(struct crs *crs, uint64_t pos)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        size_t len = cfg->ord + 1;
+        uint64_t e = pos / cfg->width;
+        uint32_t *r = crs->jump_res;
+        uint32_t v;
+        size_t i;
+        int bit;
+
+        /* Byte pos of the output belongs to step e, whose value is
+           v[ord + e], so the window after the jump is v[e .. e + ord).
+           Compute r(x) = x^e mod Q(x), then v[e] = r[0] v[0] + ... + r[ord] v[ord]. */
+        memset(r, 0, len * sizeof(*r));
+        r[0] = 1;
+        for (bit = 63; bit >= 0; --bit) {
+                crs_jump_square(crs, r, len);
+                if ((e >> bit) & 1) {
+                        crs_jump_shift(cfg, r, len);
+                }
+                /* A squaring of a long sparse recurrence is ord^2 / 2
+                   multiplications, so let others run between them. */
+                cond_resched();
+        }
+
+        for (i = 0; i < cfg->ord; ++i) {
+                v = GF_packed_dot(cfg->GF, r, cfg->jump_base, len);
+                crs->vals[i] = v;
+                crs->vals[i + cfg->ord] = v;
+                crs_jump_shift(cfg, r, len);
+                if (i % 64 == 63) {
+                        cond_resched();
+                }
+        }
+
+        crs->head = 0;
+        crs->part_len = 0;
+        if (pos % cfg->width) {
+                crs_put(crs->part, crs_next(crs), cfg->width);
+                crs->part_len = cfg->width - pos % cfg->width;
+        }
+        crs->pos = pos;
+}
+
+void crs_advance(struct crs *crs, uint64_t pos, uint8_t *buf, size_t len)
+{
+        struct crs_cfg *cfg = crs->cfg;
+        uint64_t steps, seek_cost;
+        size_t chunk;
+
+        if (pos < crs->pos) {
+                crs_seek(crs, pos);
+                return;
+        }
+
+        /* Multiplications a jump takes, roughly: 64 squarings and shifts
+           reduced by the taps of Q(x), then ord dot products for the window. */
+        steps = (pos - crs->pos) / cfg->width;
+        seek_cost = cfg->ord * (64 * (cfg->n_jump + 1) + cfg->ord);
+        if (steps > seek_cost / (cfg->n_taps + 1)) {
+                crs_seek(crs, pos);
+                return;
+        }
+
+        while (crs->pos < pos) {
+                chunk = (pos - crs->pos < len) ? pos - crs->pos : len;
+                crs_generate(crs, buf, chunk);
+        }
+}
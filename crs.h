@@ -0,0 +1,139 @@
+#pragma once
+
+#include <linux/cache.h>
+#include <linux/types.h>
+
+#include "GF.h"
+
+/* Maximum order of a CRS. */
+#define CRS_MAX_ORD 4096
+
+/* Maximum order the block engine runs at. A pass reads one table row per
+   window value, taps or not, so long windows are stepped one value at a time. */
+#define CRS_BLOCK_MAX_ORD 80
+
+/* Number of outputs the block engine produces per pass. */
+#define CRS_BLOCK 32
+
+/* Most bytes generated in one SIMD section. Entering one disables
+   preemption in the kernel, so longer requests are cut into sections. */
+#define CRS_SIMD_CHUNK 4096
+
+/* A nonzero coefficient a[idx] = coeff of a recurrence. */
+struct crs_tap {
+        uint32_t idx;
+        uint32_t coeff;
+};
+
+/* Transition of the block engine. The next CRS_BLOCK outputs are affine
+   in the window w before them:
+   out[t] = cnst[t] + M[t][0] w[0] + ... + M[t][ord - 1] w[ord - 1].
+   Column i of M is stored split into its low and high nibbles, which
+   index the GF2_8_nibble tables of w[i]. */
+struct crs_block {
+        uint8_t lo[CRS_BLOCK_MAX_ORD][CRS_BLOCK] __aligned(32);
+        uint8_t hi[CRS_BLOCK_MAX_ORD][CRS_BLOCK] __aligned(32);
+        uint8_t cnst[CRS_BLOCK] __aligned(32);
+};
+
+/* Constant recursive sequence over a packed field:
+   v[n + ord] = c + a[0] * v[n] + ... + a[ord - 1] * v[n + ord - 1],
+   stored by its nonzero coefficients only, so that a step costs one
+   multiplication per tap whatever the order. A configuration is read-only
+   once initialized and may be shared by any number of generators. */
+struct crs_cfg {
+        GF_t *GF;
+        size_t width;           /* Output bytes per step, the degree of GF over GF(2) / 8. */
+        size_t ord;
+        uint32_t cnst;
+        size_t n_taps;
+        struct crs_tap *taps;   /* By increasing index. */
+        uint32_t *vals;         /* Initial values v[0 .. ord). */
+
+        /* Because of the constant, v also satisfies the homogeneous recurrence
+           of length ord + 1 with characteristic polynomial
+           Q(x) = (x - 1)(x^ord - a[ord - 1] x^(ord - 1) - ... - a[0]).
+           jump_taps holds the n_jump nonzero coefficients of Q(x) - x^(ord + 1),
+           at most two per tap and one more, and jump_base v[0 .. ord]. */
+        size_t n_jump;
+        struct crs_tap *jump_taps;
+        uint32_t *jump_base;
+
+        /* GF2_8 of order at most CRS_BLOCK_MAX_ORD only, NULL otherwise. */
+        struct crs_block *blk;
+
+        /* Single steps over GF2_8 take a[i] * w[i] from mul_tbl[k][w[i]] for
+           the n_mul taps with i = mul_idx[k] and a[i] other than 1, and add
+           w[i] for the n_one with i = one_idx[k] and a[i] equal to 1. */
+        size_t n_mul;
+        size_t n_one;
+        uint32_t *mul_idx;
+        uint32_t *one_idx;
+        uint8_t (*mul_tbl)[256];
+
+        /* Single steps over GF2_16 take a[i] * w[i] for tap k, i = taps[k].idx,
+           from the bytes of w[i]: mul16_tbl[k][0][w[i] & 0xff] ^ mul16_tbl[k][1][w[i] >> 8]. */
+        uint16_t (*mul16_tbl)[2][256];
+};
+
+/* State of one generator. */
+struct crs {
+        struct crs_cfg *cfg;
+        uint64_t pos;           /* Index of the next byte of the output. */
+        size_t head;
+        size_t cap;             /* Largest order the buffers below have room for. */
+        /* The last ord values, oldest first, are vals[head .. head + ord).
+           Slots i and i + ord hold the same value, so the window never wraps. */
+        uint32_t *vals;
+
+        /* Bytes of the step a previous call ended inside: the last
+           part_len bytes of part are still to be output. */
+        uint8_t part[4];
+        size_t part_len;
+
+        /* Window of the block engine, as bytes. */
+        uint8_t blk_win[CRS_BLOCK_MAX_ORD];
+
+        /* Scratch polynomials for crs_seek, of cap + 1 and 2 (cap + 1) coefficients,
+           in the same allocation as vals. */
+        uint32_t *jump_res;
+        uint32_t *jump_tmp;
+} ____cacheline_aligned;
+
+/* Initialize a configuration over GF2_8, GF2_16 or GF2_32 from arrays of
+   ord elements in their packed form. Each step of the recurrence outputs
+   one element, least significant byte first. */
+int crs_cfg_init(struct crs_cfg *cfg, GF_t *GF, size_t ord, const uint32_t *coeffs,
+                 const uint32_t *vals, uint32_t cnst);
+
+/* Same as crs_cfg_init, from the n_taps coefficients listed in taps by
+   strictly increasing index. Coefficients not listed are zero. */
+int crs_cfg_init_sparse(struct crs_cfg *cfg, GF_t *GF, size_t ord, const struct crs_tap *taps,
+                        size_t n_taps, const uint32_t *vals, uint32_t cnst);
+
+/* Free the tables of a configuration. Also safe after a failed initialization. */
+void crs_cfg_destroy(struct crs_cfg *cfg);
+
+/* Set up a generator that owns no memory yet. */
+void crs_init(struct crs *crs);
+
+/* Free the buffers of a generator. */
+void crs_destroy(struct crs *crs);
+
+/* Reset a generator to the initial values of cfg, growing its buffers to
+   the order of cfg if needed. On -ENOMEM, the generator is left as it was. */
+int crs_seed(struct crs *crs, struct crs_cfg *cfg);
+
+/* Fill buf with the next len bytes of the sequence, holding the FPU for at
+   most CRS_SIMD_CHUNK bytes at a time. Does not sleep. */
+void crs_generate(struct crs *crs, uint8_t *buf, size_t len);
+
+/* Move a generator to byte pos of its output in O(ord n_taps log pos + ord^2),
+   by computing x^e mod Q(x) for the step e that byte pos belongs to. May
+   sleep. */
+void crs_seek(struct crs *crs, uint64_t pos);
+
+/* Move a generator to byte pos of its output, whichever of stepping and
+   crs_seek is cheaper. Steps generate into buf, len bytes at a time. May
+   sleep. */
+void crs_advance(struct crs *crs, uint64_t pos, uint8_t *buf, size_t len);
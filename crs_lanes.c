@@ -0,0 +1,477 @@
+#include "crs_lanes.h"
+
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_X86_64
+#include <asm/cpufeature.h>
+#endif
+
+#include "GF.h"
+#include "GF2w.h"
+
+/* Computes the next row of a batch into row, which is the copy of the
+   oldest row of the window. */
+typedef void (*crs_lanes_row_fn)(struct crs_lanes *lanes, uint8_t *row);
+
+/* Return the value of lane l in row. */
+static uint32_t crs_lanes_get(struct crs_lanes *lanes, const uint8_t *row, size_t l)
+{
+        uint32_t x = 0;
+        size_t k;
+
+        for (k = 0; k < lanes->cfg->width; ++k) {
+                x |= (uint32_t)row[k * lanes->plane + l] << (8 * k);
+        }
+        return x;
+}
+
+static void crs_lanes_set(struct crs_lanes *lanes, uint8_t *row, size_t l, uint32_t x)
+{
+        size_t k;
+
+        for (k = 0; k < lanes->cfg->width; ++k) {
+                row[k * lanes->plane + l] = x >> (8 * k);
+        }
+}
+
+/* Fill the shuffle tables of the taps of a wide configuration: entry
+   ((k * width + p) * width + q) holds byte q of the products of the
+   coefficient of tap k with the low nibbles of byte p in its first 16
+   bytes, and with the high nibbles in the next 16, as GF2_8_nibble. */
+static void crs_lanes_init_tbl(struct crs_lanes *lanes)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        size_t width = cfg->width;
+        uint8_t (*tbl)[32] = lanes->tbl;
+        uint32_t a, lo, hi;
+        size_t k, p, q, x;
+
+        for (k = 0; k < cfg->n_taps; ++k) {
+                a = cfg->taps[k].coeff;
+                for (p = 0; p < width; ++p) {
+                        for (x = 0; x < 16; ++x) {
+                                lo = GF_packed_mul(cfg->GF, a, x << (8 * p));
+                                hi = GF_packed_mul(cfg->GF, a, x << (8 * p + 4));
+                                for (q = 0; q < width; ++q) {
+                                        tbl[(k * width + p) * width + q][x] = lo >> (8 * q);
+                                        tbl[(k * width + p) * width + q][16 + x] = hi >> (8 * q);
+                                }
+                        }
+                }
+        }
+}
+
+/* Return row i of the window. */
+static inline const uint8_t *crs_lanes_win(struct crs_lanes *lanes, size_t i)
+{
+        return lanes->vals + (lanes->head + i) * lanes->row;
+}
+
+int crs_lanes_init(struct crs_lanes *lanes, struct crs_cfg *cfg, size_t n, size_t block,
+                   const uint32_t *vals)
+{
+        size_t width = cfg->width;
+        size_t ord = cfg->ord;
+        size_t i, l, q;
+        uint32_t x;
+
+        memset(lanes, 0, sizeof(*lanes));
+
+        if (!n || n > CRS_LANES_MAX || block % width || block > CRS_LANES_MAX_FRAME / n) {
+                return -EINVAL;
+        }
+        for (i = 0; i < n * ord; ++i) {
+                if (width < 4 && vals[i] >> (8 * width)) {
+                        return -EINVAL;
+                }
+        }
+
+        lanes->cfg = cfg;
+        lanes->n = n;
+        lanes->block = block;
+        lanes->plane = (n + CRS_LANES_ALIGN - 1) / CRS_LANES_ALIGN * CRS_LANES_ALIGN;
+        lanes->row = width * lanes->plane;
+        lanes->frame_size = block ? n * block : n * width;
+        for (q = 0; q < width; ++q) {
+                memset(lanes->cnst[q], cfg->cnst >> (8 * q), sizeof(lanes->cnst[q]));
+        }
+        memset(lanes->nibble, 0x0f, sizeof(lanes->nibble));
+
+        lanes->vals = kvmalloc_array(2 * ord, lanes->row, GFP_KERNEL);
+        lanes->frame = kvmalloc(lanes->frame_size, GFP_KERNEL);
+        if (width > 1 && cfg->n_taps) {
+                lanes->tbl = kvmalloc_array(cfg->n_taps * width * width, sizeof(*lanes->tbl),
+                                            GFP_KERNEL);
+        }
+        if (!lanes->vals || !lanes->frame || (width > 1 && cfg->n_taps && !lanes->tbl)) {
+                crs_lanes_destroy(lanes);
+                return -ENOMEM;
+        }
+        if (lanes->tbl) {
+                crs_lanes_init_tbl(lanes);
+        }
+
+        /* The padding of the rows is stepped like real lanes, from zero. */
+        memset(lanes->vals, 0, 2 * ord * lanes->row);
+
+        for (i = 0; i < ord; ++i) {
+                for (l = 0; l < n; ++l) {
+                        x = vals[l * ord + i];
+                        crs_lanes_set(lanes, lanes->vals + i * lanes->row, l, x);
+                        crs_lanes_set(lanes, lanes->vals + (i + ord) * lanes->row, l, x);
+                }
+        }
+
+        return 0;
+}
+
+void crs_lanes_destroy(struct crs_lanes *lanes)
+{
+        kvfree(lanes->vals);
+        kvfree(lanes->frame);
+        kvfree(lanes->tbl);
+        memset(lanes, 0, sizeof(*lanes));
+}
+
+/* A row over GF2_8 from the shared tables of the configuration. */
+static void crs_lanes_row_8(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        size_t k, l;
+        uint8_t x;
+
+        for (l = 0; l < lanes->n; ++l) {
+                x = cfg->cnst;
+                for (k = 0; k < cfg->n_one; ++k) {
+                        x ^= crs_lanes_win(lanes, cfg->one_idx[k])[l];
+                }
+                for (k = 0; k < cfg->n_mul; ++k) {
+                        x ^= cfg->mul_tbl[k][crs_lanes_win(lanes, cfg->mul_idx[k])[l]];
+                }
+                row[l] = x;
+        }
+}
+
+/* A row over GF2_16 or GF2_32, one lane at a time. The carry-less
+   products of a lane are summed and reduced once, as in crs_next. */
+static void crs_lanes_row_w(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        uint64_t acc;
+        uint32_t w;
+        size_t k, l;
+
+        /* Over GF2_16, from the byte tables of single steps instead. */
+        if (cfg->mul16_tbl) {
+                for (l = 0; l < lanes->n; ++l) {
+                        acc = cfg->cnst;
+                        for (k = 0; k < cfg->n_taps; ++k) {
+                                w = crs_lanes_get(lanes, crs_lanes_win(lanes, cfg->taps[k].idx), l);
+                                acc ^= cfg->mul16_tbl[k][0][w & 0xff] ^ cfg->mul16_tbl[k][1][w >> 8];
+                        }
+                        crs_lanes_set(lanes, row, l, acc);
+                }
+                return;
+        }
+
+        for (l = 0; l < lanes->n; ++l) {
+                acc = cfg->cnst;
+                for (k = 0; k < cfg->n_taps; ++k) {
+                        acc ^= GF2w_clmul(cfg->taps[k].coeff,
+                                          crs_lanes_get(lanes, crs_lanes_win(lanes, cfg->taps[k].idx), l));
+                }
+                crs_lanes_set(lanes, row, l, GF2w_reduce(acc, cfg->GF->I->deg, cfg->GF->Iw));
+        }
+}
+
+#ifdef CONFIG_X86_64
+/* A row over GF2_8, 32 lanes at a time. A product a * x is looked up in
+   the nibble tables of a by the low and high nibbles of x. As in
+   crs_block_avx2, the vector registers carry over between statements. */
+static void crs_lanes_row_avx2(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        const uint8_t *tbl;
+        size_t c, k;
+
+        asm volatile("vmovdqu %0, %%ymm6" : : "m" (lanes->nibble[0]));
+        for (c = 0; c < lanes->row; c += 32) {
+                asm volatile("vmovdqu %0, %%ymm7" : : "m" (lanes->cnst[0][0]));
+                for (k = 0; k < cfg->n_one; ++k) {
+                        asm volatile("vpxor %0, %%ymm7, %%ymm7"
+                                     :
+                                     : "m" (crs_lanes_win(lanes, cfg->one_idx[k])[c]));
+                }
+                for (k = 0; k < cfg->n_mul; ++k) {
+                        tbl = GF2_8_nibble[cfg->mul_tbl[k][1]];
+                        asm volatile("vmovdqu %0, %%ymm0\n\t"
+                                     "vpsrlw $4, %%ymm0, %%ymm1\n\t"
+                                     "vpand %%ymm6, %%ymm0, %%ymm0\n\t"
+                                     "vpand %%ymm6, %%ymm1, %%ymm1\n\t"
+                                     "vbroadcasti128 %1, %%ymm2\n\t"
+                                     "vbroadcasti128 %2, %%ymm3\n\t"
+                                     "vpshufb %%ymm0, %%ymm2, %%ymm2\n\t"
+                                     "vpshufb %%ymm1, %%ymm3, %%ymm3\n\t"
+                                     "vpxor %%ymm2, %%ymm7, %%ymm7\n\t"
+                                     "vpxor %%ymm3, %%ymm7, %%ymm7"
+                                     :
+                                     : "m" (crs_lanes_win(lanes, cfg->mul_idx[k])[c]),
+                                       "m" (tbl[0]), "m" (tbl[16]));
+                }
+                asm volatile("vmovdqu %%ymm7, %0" : "=m" (row[c]) : : "memory");
+        }
+        asm volatile("vzeroupper");
+}
+
+/* Same as crs_lanes_row_avx2, 16 lanes at a time. */
+static void crs_lanes_row_ssse3(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        const uint8_t *tbl;
+        size_t c, k;
+
+        asm volatile("movdqu %0, %%xmm6" : : "m" (lanes->nibble[0]));
+        for (c = 0; c < lanes->row; c += 16) {
+                asm volatile("movdqu %0, %%xmm7" : : "m" (lanes->cnst[0][0]));
+                for (k = 0; k < cfg->n_one; ++k) {
+                        asm volatile("movdqu %0, %%xmm0\n\t"
+                                     "pxor %%xmm0, %%xmm7"
+                                     :
+                                     : "m" (crs_lanes_win(lanes, cfg->one_idx[k])[c]));
+                }
+                for (k = 0; k < cfg->n_mul; ++k) {
+                        tbl = GF2_8_nibble[cfg->mul_tbl[k][1]];
+                        asm volatile("movdqu %0, %%xmm0\n\t"
+                                     "movdqa %%xmm0, %%xmm1\n\t"
+                                     "psrlw $4, %%xmm1\n\t"
+                                     "pand %%xmm6, %%xmm0\n\t"
+                                     "pand %%xmm6, %%xmm1\n\t"
+                                     "movdqa %1, %%xmm2\n\t"
+                                     "movdqa %2, %%xmm3\n\t"
+                                     "pshufb %%xmm0, %%xmm2\n\t"
+                                     "pshufb %%xmm1, %%xmm3\n\t"
+                                     "pxor %%xmm2, %%xmm7\n\t"
+                                     "pxor %%xmm3, %%xmm7"
+                                     :
+                                     : "m" (crs_lanes_win(lanes, cfg->mul_idx[k])[c]),
+                                       "m" (tbl[0]), "m" (tbl[16]));
+                }
+                asm volatile("movdqu %%xmm7, %0" : "=m" (row[c]) : : "memory");
+        }
+}
+
+/* A row over GF2_16 or GF2_32, 32 lanes at a time. Byte plane q of the
+   row sums, over the taps and the byte planes p of their values, the
+   lookups of the nibbles of plane p in the tables of (tap, p, q), as in
+   crs_lanes_row_avx2. */
+static void crs_lanes_row_wide_avx2(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        size_t width = cfg->width;
+        size_t plane = lanes->plane;
+        const uint8_t *tbl;
+        size_t c, k, p, q;
+
+        asm volatile("vmovdqu %0, %%ymm6" : : "m" (lanes->nibble[0]));
+        for (q = 0; q < width; ++q) {
+                for (c = 0; c < plane; c += 32) {
+                        asm volatile("vmovdqu %0, %%ymm7" : : "m" (lanes->cnst[q][0]));
+                        for (k = 0; k < cfg->n_taps; ++k) {
+                                for (p = 0; p < width; ++p) {
+                                        tbl = lanes->tbl[(k * width + p) * width + q];
+                                        asm volatile("vmovdqu %0, %%ymm0\n\t"
+                                                     "vpsrlw $4, %%ymm0, %%ymm1\n\t"
+                                                     "vpand %%ymm6, %%ymm0, %%ymm0\n\t"
+                                                     "vpand %%ymm6, %%ymm1, %%ymm1\n\t"
+                                                     "vbroadcasti128 %1, %%ymm2\n\t"
+                                                     "vbroadcasti128 %2, %%ymm3\n\t"
+                                                     "vpshufb %%ymm0, %%ymm2, %%ymm2\n\t"
+                                                     "vpshufb %%ymm1, %%ymm3, %%ymm3\n\t"
+                                                     "vpxor %%ymm2, %%ymm7, %%ymm7\n\t"
+                                                     "vpxor %%ymm3, %%ymm7, %%ymm7"
+                                                     :
+                                                     : "m" (crs_lanes_win(lanes, cfg->taps[k].idx)[p * plane + c]),
+                                                       "m" (tbl[0]), "m" (tbl[16]));
+                                }
+                        }
+                        asm volatile("vmovdqu %%ymm7, %0" : "=m" (row[q * plane + c]) : : "memory");
+                }
+        }
+        asm volatile("vzeroupper");
+}
+
+/* Same as crs_lanes_row_wide_avx2, 16 lanes at a time. */
+static void crs_lanes_row_wide_ssse3(struct crs_lanes *lanes, uint8_t *row)
+{
+        struct crs_cfg *cfg = lanes->cfg;
+        size_t width = cfg->width;
+        size_t plane = lanes->plane;
+        const uint8_t *tbl;
+        size_t c, k, p, q;
+
+        asm volatile("movdqu %0, %%xmm6" : : "m" (lanes->nibble[0]));
+        for (q = 0; q < width; ++q) {
+                for (c = 0; c < plane; c += 16) {
+                        asm volatile("movdqu %0, %%xmm7" : : "m" (lanes->cnst[q][0]));
+                        for (k = 0; k < cfg->n_taps; ++k) {
+                                for (p = 0; p < width; ++p) {
+                                        tbl = lanes->tbl[(k * width + p) * width + q];
+                                        asm volatile("movdqu %0, %%xmm0\n\t"
+                                                     "movdqa %%xmm0, %%xmm1\n\t"
+                                                     "psrlw $4, %%xmm1\n\t"
+                                                     "pand %%xmm6, %%xmm0\n\t"
+                                                     "pand %%xmm6, %%xmm1\n\t"
+                                                     "movdqu %1, %%xmm2\n\t"
+                                                     "movdqu %2, %%xmm3\n\t"
+                                                     "pshufb %%xmm0, %%xmm2\n\t"
+                                                     "pshufb %%xmm1, %%xmm3\n\t"
+                                                     "pxor %%xmm2, %%xmm7\n\t"
+                                                     "pxor %%xmm3, %%xmm7"
+                                                     :
+                                                     : "m" (crs_lanes_win(lanes, cfg->taps[k].idx)[p * plane + c]),
+                                                       "m" (tbl[0]), "m" (tbl[16]));
+                                }
+                        }
+                        asm volatile("movdqu %%xmm7, %0" : "=m" (row[q * plane + c]) : : "memory");
+                }
+        }
+}
+
+/* Return the vector row kernel usable inside a SIMD section, or NULL. */
+static crs_lanes_row_fn crs_lanes_row_simd(struct crs_lanes *lanes)
+{
+        bool wide = lanes->cfg->GF != &GF2_8;
+
+        /* A wide row costs width^2 shuffles per tap and vector whatever
+           the number of lanes, so with fewer lanes than bytes per value,
+           mostly padding, one lane at a time is faster. */
+        if (wide && lanes->n < lanes->cfg->width) {
+                return NULL;
+        }
+        if (boot_cpu_has(X86_FEATURE_AVX2)) {
+                return wide ? crs_lanes_row_wide_avx2 : crs_lanes_row_avx2;
+        }
+        if (boot_cpu_has(X86_FEATURE_SSSE3)) {
+                return wide ? crs_lanes_row_wide_ssse3 : crs_lanes_row_ssse3;
+        }
+        return NULL;
+}
+#else
+static crs_lanes_row_fn crs_lanes_row_simd(struct crs_lanes *lanes)
+{
+        return NULL;
+}
+#endif
+
+/* The SIMD section steps are taken in, the row kernel it allows and the
+   bytes of rows computed in it so far. */
+struct crs_lanes_section {
+        bool simd;
+        crs_lanes_row_fn fn;
+        size_t len;
+};
+
+static void crs_lanes_section_begin(struct crs_lanes *lanes, struct crs_lanes_section *sec)
+{
+        sec->fn = NULL;
+        sec->len = 0;
+        sec->simd = GF2w_simd_begin();
+        if (sec->simd) {
+                sec->fn = crs_lanes_row_simd(lanes);
+        }
+        if (!sec->fn) {
+                sec->fn = (lanes->cfg->GF == &GF2_8) ? crs_lanes_row_8 : crs_lanes_row_w;
+        }
+}
+
+static void crs_lanes_section_end(struct crs_lanes_section *sec)
+{
+        if (sec->simd) {
+                GF2w_simd_end();
+        }
+}
+
+/* Advance every lane by one step and return the new row. A row is at most
+   CRS_LANES_MAX * 4 bytes, so a new section is started whenever the next
+   row would take the current one past CRS_SIMD_CHUNK bytes. */
+static const uint8_t *crs_lanes_step(struct crs_lanes *lanes, struct crs_lanes_section *sec)
+{
+        size_t ord = lanes->cfg->ord;
+        size_t bytes = lanes->n * lanes->cfg->width;
+        uint8_t *row = lanes->vals + lanes->head * lanes->row;
+
+        if (sec->len && sec->len + bytes > CRS_SIMD_CHUNK) {
+                crs_lanes_section_end(sec);
+                crs_lanes_section_begin(lanes, sec);
+        }
+        /* The copy of the oldest row is not part of the window, so the
+           kernels can read the whole window while they write there. */
+        sec->fn(lanes, row + ord * lanes->row);
+        sec->len += bytes;
+        memcpy(row, row + ord * lanes->row, lanes->row);
+        lanes->head = (lanes->head + 1 == ord) ? 0 : lanes->head + 1;
+
+        return row;
+}
+
+/* Write the next frame to out. */
+static void crs_lanes_frame(struct crs_lanes *lanes, uint8_t *out, struct crs_lanes_section *sec)
+{
+        size_t width = lanes->cfg->width;
+        const uint8_t *row;
+        uint8_t *dst;
+        size_t t, l, k;
+
+        if (!lanes->block && width == 1) {
+                memcpy(out, crs_lanes_step(lanes, sec), lanes->n);
+                return;
+        }
+
+        /* Byte stores, since a call to memcpy per element costs more than
+           the step itself. A step gives width bytes of each lane, one from
+           each byte plane of the row. */
+        for (t = 0; t < (lanes->block ? lanes->block : width); t += width) {
+                row = crs_lanes_step(lanes, sec);
+                dst = out + t;
+                for (l = 0; l < lanes->n; ++l, dst += lanes->block ? lanes->block : width) {
+                        for (k = 0; k < width; ++k) {
+                                dst[k] = row[k * lanes->plane + l];
+                        }
+                }
+        }
+}
+
+/* Output what is left of a partially output frame. Returns the number of bytes written. */
+static size_t crs_lanes_drain(struct crs_lanes *lanes, uint8_t *buf, size_t len)
+{
+        size_t n = (len < lanes->frame_len) ? len : lanes->frame_len;
+
+        memcpy(buf, lanes->frame + lanes->frame_size - lanes->frame_len, n);
+        lanes->frame_len -= n;
+
+        return n;
+}
+
+void crs_lanes_generate(struct crs_lanes *lanes, uint8_t *buf, size_t len)
+{
+        size_t size = lanes->frame_size;
+        struct crs_lanes_section sec;
+        size_t i;
+
+        i = crs_lanes_drain(lanes, buf, len);
+
+        crs_lanes_section_begin(lanes, &sec);
+        for (; i + size <= len; i += size) {
+                crs_lanes_frame(lanes, buf + i, &sec);
+        }
+        if (i < len) {
+                crs_lanes_frame(lanes, lanes->frame, &sec);
+                lanes->frame_len = size;
+                crs_lanes_drain(lanes, buf + i, len - i);
+        }
+        crs_lanes_section_end(&sec);
+        lanes->pos += len;
+}
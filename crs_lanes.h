@@ -0,0 +1,69 @@
+#pragma once
+
+#include <linux/types.h>
+
+#include "crs.h"
+
+/* Maximum number of lanes of a batch. */
+#define CRS_LANES_MAX 1024
+
+/* Maximum size of a frame of blocked output. A call that ends inside a
+   frame generates all of it into a buffer of this size. */
+#define CRS_LANES_MAX_FRAME (64 * 1024)
+
+/* Byte planes of the rows of the window are padded to this many bytes,
+   the width of the widest vector the steps use. */
+#define CRS_LANES_ALIGN 32
+
+/* n copies of the recurrence of one configuration, each from its own
+   initial values. The state is stored by value index rather than by lane:
+   row i holds value i of every lane, so that a step computes a whole row
+   with the same coefficients, many lanes per instruction, and reads the
+   multiplication tables of the configuration once for all lanes. A row is
+   cfg->width byte planes, plane k holding byte k of the value of every
+   lane, so that the bytes of wide values are multiplied by byte shuffles
+   like those of GF2_8.
+
+   The output comes in frames. With block 0, a frame is one step of every
+   lane, lane 0 first. Otherwise it is block bytes of lane 0, then block
+   bytes of lane 1, and so on. */
+struct crs_lanes {
+        struct crs_cfg *cfg;
+        size_t n;
+        size_t block;
+        size_t plane;           /* Bytes per byte plane, n padded to CRS_LANES_ALIGN. */
+        size_t row;             /* Bytes per row, width * plane. */
+        uint64_t pos;           /* Index of the next byte of the output. */
+
+        /* As in struct crs, rows head .. head + ord are the window, oldest
+           first, and row i + ord repeats row i. */
+        size_t head;
+        uint8_t *vals;
+
+        /* The last frame_len bytes of the frame_size bytes of frame are
+           still to be output. */
+        uint8_t *frame;
+        size_t frame_size;
+        size_t frame_len;
+
+        /* The bytes of the constant and the nibble mask, repeated across
+           a vector. */
+        uint8_t cnst[4][CRS_LANES_ALIGN];
+        uint8_t nibble[CRS_LANES_ALIGN];
+
+        /* Shuffle tables of the taps over GF2_16 and GF2_32, NULL over GF2_8. */
+        uint8_t (*tbl)[32];
+};
+
+/* Set up n lanes of cfg, which must outlive them. Lane l starts from
+   vals[l * ord .. (l + 1) * ord), in packed form. block is 0 or a multiple
+   of the width of cfg, with n * block at most CRS_LANES_MAX_FRAME. */
+int crs_lanes_init(struct crs_lanes *lanes, struct crs_cfg *cfg, size_t n, size_t block,
+                   const uint32_t *vals);
+
+/* Free the buffers of a batch. */
+void crs_lanes_destroy(struct crs_lanes *lanes);
+
+/* Fill buf with the next len bytes of the output, holding the FPU for at
+   most CRS_SIMD_CHUNK bytes of steps at a time. Does not sleep. */
+void crs_lanes_generate(struct crs_lanes *lanes, uint8_t *buf, size_t len);
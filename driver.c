@@ -1,17 +1,43 @@
 #include <linux/atomic.h>      /* Atomic operations usable in machine independent code */
+#include <linux/capability.h>  /* capable() */
 #include <linux/cdev.h>        /* Character device manipulation */
+#include <linux/debugfs.h>     /* Debug file system */
 #include <linux/fs.h>          /* Definitions for file table structures */
 #include <linux/init.h>        /* Macros used to mark some functions or initialize data */
+#include <linux/kref.h>        /* Reference counting */
+#include <linux/ktime.h>       /* Timestamps */
+#include <linux/log2.h>        /* ilog2() */
+#include <linux/math64.h>      /* 64-bit division */
+#include <linux/mm.h>          /* Memory mappings */
 #include <linux/module.h>      /* Required by all modules */
+#include <linux/overflow.h>    /* Checked arithmetic */
+#include <linux/percpu.h>      /* Per-CPU statistics */
 #include <linux/moduleparam.h> /* Module parameters */
+#include <linux/mutex.h>       /* Sleeping locks */
+#include <linux/poll.h>        /* Readiness notification */
 #include <linux/printk.h>      /* For logging */
+#include <linux/rcupdate.h>    /* Read-copy-update */
+#include <linux/sched.h>       /* cond_resched() */
+#include <linux/sched/signal.h> /* signal_pending() */
+#include <linux/seq_file.h>    /* Sequential file interface for debugfs */
+#include <linux/slab.h>        /* Kernel memory allocation */
 #include <linux/types.h>       /* Linux specific types */
+#include <linux/uio.h>         /* I/O vector iterators */
+#include <linux/vmalloc.h>     /* Memory that can be mapped to user space */
+#include <linux/wait.h>        /* Wait queues */
+#include <linux/workqueue.h>   /* Deferred work */
 #include <asm/uaccess.h>       /* User space memory access functions */
 
 #include "GF.h"
+#include "crs.h"
+#include "crs_lanes.h"
 #include "poly.h"
+#include "rngdrv.h"
 #include "utils.h"
 
+#define CREATE_TRACE_POINTS
+#include "rngdrv_trace.h"
+
 #define DEVICE_NAME "rngdrv"
 
 MODULE_LICENSE("GPL");
@@ -20,68 +46,841 @@ MODULE_DESCRIPTION("A pseudo-random number generator.");
 
 #define SUCCESS 0
 
-#define MAX_LENGTH 80
+#define MAX_LENGTH RNGDRV_MAX_ORD
+
+static_assert(RNGDRV_MAX_SPARSE_ORD == CRS_MAX_ORD);
+static_assert(sizeof(struct rngdrv_tap) == sizeof(struct crs_tap));
+static_assert(RNGDRV_MAX_LANES == CRS_LANES_MAX);
+static_assert(RNGDRV_MAX_LANE_FRAME == CRS_LANES_MAX_FRAME);
+
+/* Upper bound of the taps given at load time. */
+#define PARAM_TAPS RNGDRV_MAX_SPARSE_TAPS
+
+/* Size of the kernel staging buffer bytes are generated into before being
+   copied to user space. */
+#define STAGING_SIZE PAGE_SIZE
+
+/* Length of the ring mapping: the control page and the data. */
+#define RING_MAP_SIZE (PAGE_SIZE + RNGDRV_RING_SIZE)
+
+/* Upper bound of pool_high. */
+#define POOL_MAX (1 << 20)
+
+/* Upper bound of minors. */
+#define MINORS_MAX 64
+
+/* Upper bound of the generators of a shared device. */
+#define SLOTS_MAX 64
+
+static unsigned int minors = 1;
+module_param(minors, uint, 0444);
+MODULE_PARM_DESC(minors, "Number of devices, /dev/rngdrv0 to /dev/rngdrv<minors - 1>");
 
 static size_t crs_ord = 0;
 module_param(crs_ord, ulong, 0);
 MODULE_PARM_DESC(crs_ord, "Order of the CRS");
 
-static uint8_t crs_const = 0;
-module_param(crs_const, byte, 0);
+static unsigned int crs_width = 8;
+module_param(crs_width, uint, 0);
+MODULE_PARM_DESC(crs_width, "Field width in bits: 8, 16 or 32. 8 is the fastest per byte");
+
+static uint32_t crs_const = 0;
+module_param(crs_const, uint, 0);
 MODULE_PARM_DESC(crs_const, "CRS constant");
 
-static uint8_t crs_coeffs[MAX_LENGTH];
-module_param_array(crs_coeffs, byte, NULL, 0);
+static uint32_t crs_coeffs[MAX_LENGTH];
+module_param_array(crs_coeffs, uint, NULL, 0);
 MODULE_PARM_DESC(crs_coeffs, "An array of CRS coefficients");
 
-static uint8_t crs_vals[MAX_LENGTH];
-module_param_array(crs_vals, byte, NULL, 0);
-MODULE_PARM_DESC(crs_vals, "An array of initial CRS bytes");
+static uint32_t crs_vals[MAX_LENGTH];
+module_param_array(crs_vals, uint, NULL, 0);
+MODULE_PARM_DESC(crs_vals, "An array of initial CRS values");
 
-static GF_elem_t *crs_gf_const = NULL;
-static GF_elem_t *crs_gf_coeffs[MAX_LENGTH];
-static GF_elem_t *crs_gf_vals[MAX_LENGTH];
-static GF_elem_t *acc_sum = NULL;
-static GF_elem_t *prod = NULL;
+static uint32_t crs_taps[2 * PARAM_TAPS];
+static int crs_taps_count;
+module_param_array(crs_taps, uint, &crs_taps_count, 0);
+MODULE_PARM_DESC(crs_taps, "Nonzero CRS coefficients as index,coefficient pairs, instead of crs_coeffs");
 
-static int rngdrv_open(struct inode *inode, struct file *file);
-static int rngdrv_release(struct inode *inode, struct file *file);
-static ssize_t rngdrv_write(struct file *filp, const char __user *buffer, size_t length, loff_t *offset);
-static ssize_t rngdrv_read(struct file *filp, char __user *buffer, size_t length, loff_t *offset);
+static bool shared;
+module_param(shared, bool, 0444);
+MODULE_PARM_DESC(shared, "Files of a device read disjoint chunks of one sequence instead of their own");
+
+static unsigned int pool_low = 16384;
+module_param(pool_low, uint, 0444);
+MODULE_PARM_DESC(pool_low, "Prefill a file's pool when it holds fewer bytes than this");
+
+static unsigned int pool_high = 65536;
+module_param(pool_high, uint, 0444);
+MODULE_PARM_DESC(pool_high, "Size of a file's prefill pool in bytes, 0 to disable prefill");
+
+/* A recurrence configuration, shared by the files using it. */
+struct rngdrv_cfg {
+        struct kref ref;
+        struct rcu_head rcu;
+        struct crs_cfg crs;
+};
+
+/* Recurrence every minor starts with, built from the parameters above. */
+static struct rngdrv_cfg *rngdrv_cfg_default;
+
+/* Generator of a shared device. It is a checkpoint in the device's
+   sequence: a reader locks one, moves it forward to the range it claimed,
+   by stepping or jumping, and generates the range there. Slots are locked
+   from different CPUs, so each has cache lines of its own. */
+struct rngdrv_slot {
+        struct crs crs;
+        struct mutex lock;
+        struct rngdrv_cfg *cfg; /* Configuration of crs, referenced, or NULL before the first use. */
+        uint8_t *staging;       /* Allocated on the first use. */
+} ____cacheline_aligned;
+
+/* A device minor, allocated on its first open and kept until the module
+   is unloaded, so that its configuration outlives the files using it. */
+struct rngdrv_dev {
+        /* Recurrence files of the minor follow. Readers only dereference it
+           under RCU; updates are serialized by rngdrv_cfg_lock and drop the
+           reference the pointer held. */
+        struct rngdrv_cfg __rcu *cfg;
+
+        /* With shared set, readers claim disjoint ranges of one sequence by
+           advancing pos, the index of its first unclaimed byte, and produce
+           them with any of the n_slots generators. No lock is common to all
+           readers. */
+        atomic64_t pos;
+        struct rngdrv_slot **slots;
+        unsigned int n_slots;
+        struct work_struct refresh;     /* Brings a generator to pos for nonblocking readers. */
+};
+
+static struct rngdrv_dev *rngdrv_devs[MINORS_MAX];
+static DEFINE_MUTEX(rngdrv_devs_lock);
+static DEFINE_MUTEX(rngdrv_cfg_lock);
+
+/* Generator owned by an open file. */
+struct rngdrv_file {
+        struct crs crs;
+        struct rngdrv_dev *dev; /* Minor the file was opened on. */
+        struct mutex lock;      /* Serializes readers sharing the file. */
+        struct rngdrv_cfg *cfg; /* Configuration of crs, referenced. NULL on shared devices. */
+        bool seeded;            /* Reseeded privately or in lanes mode, so cfg stays when the device's changes. */
+        struct crs_lanes *lanes;        /* Lanes of cfg the file outputs instead of crs, or NULL. */
+        uint8_t *staging;       /* Bytes are generated here before being copied to user space. */
+        struct rngdrv_ring_ctl *ring;   /* Mapped ring, created on the first mmap. */
+        struct mutex ring_lock; /* Serializes creating the ring. Never held across a user copy. */
+        uint64_t ring_head;     /* The driver's copy of ring->head, which user space can overwrite. */
+
+        /* Prefilled output: the pool_len bytes before crs.pos, starting at
+           pool[pool_head] and wrapping at pool_high. NULL if prefill is off. */
+        uint8_t *pool;
+        size_t pool_head;
+        size_t pool_len;
+        uint64_t next_pos;      /* Sequence index the next read is expected at, where prefill moves the pool. */
+        struct work_struct prefill;
+        wait_queue_head_t wait; /* Woken when the pool gains bytes. */
+};
 
-enum {
-        CDEV_NOT_USED = 0,
-        CDEV_EXCLUSIVE_OPEN = 1,
+#define READ_NS_BUCKETS 64
+
+/* Read path statistics. Every CPU counts into its own copy, so readers
+   never contend on them; debugfs shows the sums. */
+struct rngdrv_stats {
+        u64 generated;          /* Bytes produced by the generators. */
+        u64 reads;
+        u64 read_bytes;         /* Bytes returned by reads. */
+        u64 read_busy;          /* Non-blocking reads rejected with -EAGAIN. */
+        u64 slot_busy;          /* Shared reads that found their generator in use. */
+        u64 open_rejected;
+        u64 read_ns[READ_NS_BUCKETS];   /* read_ns[k] counts reads taking [2^k, 2^(k + 1)) ns. */
 };
 
-static atomic_t cdev_status = ATOMIC_INIT(CDEV_NOT_USED);
+static DEFINE_PER_CPU(struct rngdrv_stats, rngdrv_stats);
+
+/* Cache-line aligned, so that generators of different files never share a line. */
+static struct kmem_cache *file_cache;
+
+/* Generators of shared devices, aligned likewise, or NULL without shared. */
+static struct kmem_cache *slot_cache;
+
+static int rngdrv_open(struct inode *inode, struct file *file);
+static int rngdrv_release(struct inode *inode, struct file *file);
+static ssize_t rngdrv_write(struct file *filp, const char __user *buffer, size_t length, loff_t *offset);
+static ssize_t rngdrv_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static loff_t rngdrv_llseek(struct file *file, loff_t offset, int whence);
+static int rngdrv_mmap(struct file *file, struct vm_area_struct *vma);
+static long rngdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static __poll_t rngdrv_poll(struct file *file, poll_table *wait);
 
-static int major;
+static dev_t rngdrv_devt;
+static struct cdev rngdrv_cdev;
 static struct class *cls;
+static struct dentry *debugfs_dir;
 
 static struct file_operations fops = {
         .owner = THIS_MODULE,
         .open = rngdrv_open,
         .release = rngdrv_release,
         .write = rngdrv_write,
-        .read = rngdrv_read,
+        .read_iter = rngdrv_read_iter,
+        .splice_read = copy_splice_read,
+        .llseek = rngdrv_llseek,
+        .mmap = rngdrv_mmap,
+        .unlocked_ioctl = rngdrv_ioctl,
+        .compat_ioctl = compat_ptr_ioctl,
+        .poll = rngdrv_poll,
 };
 
+static void rngdrv_stats_read(ssize_t ret, u64 ns)
+{
+        this_cpu_inc(rngdrv_stats.reads);
+        if (ret > 0) {
+                this_cpu_add(rngdrv_stats.read_bytes, ret);
+        } else if (ret == -EAGAIN) {
+                this_cpu_inc(rngdrv_stats.read_busy);
+        }
+        this_cpu_inc(rngdrv_stats.read_ns[ns ? ilog2(ns) : 0]);
+}
+
+/* crs_generate, or crs_lanes_generate if lanes is not NULL, counted. If
+   gen_ns is not NULL, the time taken is added to it. */
+static void rngdrv_generate(struct crs *crs, struct crs_lanes *lanes, uint8_t *buf, size_t len,
+                            u64 *gen_ns)
+{
+        u64 start = 0;
+
+        if (gen_ns) {
+                start = ktime_get_ns();
+        }
+        if (lanes) {
+                crs_lanes_generate(lanes, buf, len);
+        } else {
+                crs_generate(crs, buf, len);
+        }
+        if (gen_ns) {
+                *gen_ns += ktime_get_ns() - start;
+        }
+        this_cpu_add(rngdrv_stats.generated, len);
+}
+
+/* Free lanes set up by rngdrv_set_lanes, if any. */
+static void rngdrv_lanes_free(struct crs_lanes *lanes)
+{
+        if (lanes) {
+                crs_lanes_destroy(lanes);
+                kfree(lanes);
+        }
+}
+
+/* Return the field of the given width in bits, or NULL. */
+static GF_t *rngdrv_field(unsigned int width)
+{
+        switch (width) {
+        case 8:
+                return &GF2_8;
+        case 16:
+                return &GF2_16;
+        case 32:
+                return &GF2_32;
+        default:
+                return NULL;
+        }
+}
+
+/* Finish a configuration whose recurrence was initialized with result ret. */
+static struct rngdrv_cfg *rngdrv_cfg_finish(struct rngdrv_cfg *cfg, int ret)
+{
+        if (ret) {
+                kfree(cfg);
+                return ERR_PTR(ret);
+        }
+
+        kref_init(&cfg->ref);
+        return cfg;
+}
+
+static struct rngdrv_cfg *rngdrv_cfg_create(GF_t *GF, size_t ord, const uint32_t *coeffs,
+                                            const uint32_t *vals, uint32_t cnst)
+{
+        struct rngdrv_cfg *cfg;
+
+        cfg = kmalloc(sizeof(*cfg), GFP_KERNEL);
+        if (!cfg) {
+                return ERR_PTR(-ENOMEM);
+        }
+
+        return rngdrv_cfg_finish(cfg, crs_cfg_init(&cfg->crs, GF, ord, coeffs, vals, cnst));
+}
+
+static struct rngdrv_cfg *rngdrv_cfg_create_sparse(GF_t *GF, size_t ord, const struct crs_tap *taps,
+                                                   size_t n_taps, const uint32_t *vals, uint32_t cnst)
+{
+        struct rngdrv_cfg *cfg;
+
+        cfg = kmalloc(sizeof(*cfg), GFP_KERNEL);
+        if (!cfg) {
+                return ERR_PTR(-ENOMEM);
+        }
+
+        return rngdrv_cfg_finish(cfg, crs_cfg_init_sparse(&cfg->crs, GF, ord, taps, n_taps,
+                                                          vals, cnst));
+}
+
+static void rngdrv_cfg_free(struct rcu_head *rcu)
+{
+        struct rngdrv_cfg *cfg = container_of(rcu, struct rngdrv_cfg, rcu);
+
+        crs_cfg_destroy(&cfg->crs);
+        kfree(cfg);
+}
+
+static void rngdrv_cfg_release(struct kref *ref)
+{
+        struct rngdrv_cfg *cfg = container_of(ref, struct rngdrv_cfg, ref);
+
+        /* Readers may still be looking at it under RCU. */
+        call_rcu(&cfg->rcu, rngdrv_cfg_free);
+}
+
+static void rngdrv_cfg_put(struct rngdrv_cfg *cfg)
+{
+        kref_put(&cfg->ref, rngdrv_cfg_release);
+}
+
+/* Return a reference to the configuration of dev. */
+static struct rngdrv_cfg *rngdrv_cfg_get(struct rngdrv_dev *dev)
+{
+        struct rngdrv_cfg *cfg;
+
+        rcu_read_lock();
+        /* A configuration whose count dropped to zero has already been
+           replaced, so looking again finds its successor. */
+        do {
+                cfg = rcu_dereference(dev->cfg);
+        } while (!kref_get_unless_zero(&cfg->ref));
+        rcu_read_unlock();
+
+        return cfg;
+}
+
+/* Make cfg the configuration of dev, taking over the caller's reference. */
+static void rngdrv_cfg_publish(struct rngdrv_dev *dev, struct rngdrv_cfg *cfg)
+{
+        struct rngdrv_cfg *old;
+
+        mutex_lock(&rngdrv_cfg_lock);
+        old = rcu_replace_pointer(dev->cfg, cfg, lockdep_is_held(&rngdrv_cfg_lock));
+        mutex_unlock(&rngdrv_cfg_lock);
+
+        if (old) {
+                rngdrv_cfg_put(old);
+        }
+}
+
+/* Run the file on cfg from sequence index pos, taking over the caller's
+   reference. If the generator cannot grow to the order of cfg, the file
+   stays as it was and cfg is dropped. Called with ctx->lock held. */
+static int rngdrv_cfg_switch(struct rngdrv_file *ctx, struct rngdrv_cfg *cfg, uint64_t pos)
+{
+        int ret;
+
+        ret = crs_seed(&ctx->crs, &cfg->crs);
+        if (ret) {
+                rngdrv_cfg_put(cfg);
+                return ret;
+        }
+
+        rngdrv_cfg_put(ctx->cfg);
+        ctx->cfg = cfg;
+        ctx->pool_head = 0;
+        ctx->pool_len = 0;
+        if (pos) {
+                crs_seek(&ctx->crs, pos);
+        }
+        return 0;
+}
+
+/* Move the file to a new configuration of its minor, if one was published,
+   keeping the index of the next byte it hands out. The check is a
+   single pointer comparison, so readers do not contend on updates. Out of
+   memory, the file keeps its configuration and tries again on its next
+   access. Called with ctx->lock held. */
+static void rngdrv_cfg_sync(struct rngdrv_file *ctx)
+{
+        if (ctx->seeded || rcu_access_pointer(ctx->dev->cfg) == ctx->cfg) {
+                return;
+        }
+        rngdrv_cfg_switch(ctx, rngdrv_cfg_get(ctx->dev), ctx->crs.pos - ctx->pool_len);
+}
+
+/* Drop the pool unless it starts at sequence index pos, and make sure
+   the generator is then at pos. Called with ctx->lock held. */
+static void rngdrv_pool_sync(struct rngdrv_file *ctx, uint64_t pos)
+{
+        rngdrv_cfg_sync(ctx);
+        if (ctx->crs.pos - ctx->pool_len == pos) {
+                return;
+        }
+        ctx->pool_head = 0;
+        ctx->pool_len = 0;
+        crs_seek(&ctx->crs, pos);
+}
+
+/* Return true if a read at sequence index pos can start on the pool as it
+   is, without a new configuration or a seek. */
+static bool rngdrv_pool_ready(struct rngdrv_file *ctx, uint64_t pos)
+{
+        if (!ctx->seeded && rcu_access_pointer(ctx->dev->cfg) != ctx->cfg) {
+                return false;
+        }
+        return READ_ONCE(ctx->crs.pos) - READ_ONCE(ctx->pool_len) == pos;
+}
+
+static void rngdrv_pool_consume(struct rngdrv_file *ctx, size_t len)
+{
+        ctx->pool_head += len;
+        if (ctx->pool_head == pool_high) {
+                ctx->pool_head = 0;
+        }
+        ctx->pool_len -= len;
+}
+
+/* Copy up to len pooled bytes to buf and return how many were taken.
+   Called with ctx->lock held. */
+static size_t rngdrv_pool_take(struct rngdrv_file *ctx, uint8_t *buf, size_t len)
+{
+        size_t done = 0, chunk;
+
+        while (done < len && ctx->pool_len) {
+                chunk = min3(len - done, ctx->pool_len, pool_high - ctx->pool_head);
+                memcpy(buf + done, ctx->pool + ctx->pool_head, chunk);
+                rngdrv_pool_consume(ctx, chunk);
+                done += chunk;
+        }
+
+        return done;
+}
+
+static void rngdrv_pool_kick(struct rngdrv_file *ctx)
+{
+        if (ctx->pool && !ctx->lanes && ctx->pool_len < pool_low) {
+                queue_work(system_unbound_wq, &ctx->prefill);
+        }
+}
+
+/* Top the pool up to pool_high a page at a time, dropping the lock
+   in between so that readers are never held up for long. The pool is
+   first moved to the configuration of the device and to next_pos, which
+   nonblocking reads leave to this worker. */
+static void rngdrv_prefill(struct work_struct *work)
+{
+        struct rngdrv_file *ctx = container_of(work, struct rngdrv_file, prefill);
+        size_t tail, chunk;
+
+        for (;;) {
+                mutex_lock(&ctx->lock);
+                if (!ctx->lanes) {
+                        rngdrv_pool_sync(ctx, ctx->next_pos);
+                }
+                if (ctx->lanes || ctx->pool_len == pool_high) {
+                        mutex_unlock(&ctx->lock);
+                        break;
+                }
+
+                tail = ctx->pool_head + ctx->pool_len;
+                if (tail >= pool_high) {
+                        tail -= pool_high;
+                }
+                chunk = min3((size_t)PAGE_SIZE, pool_high - ctx->pool_len, pool_high - tail);
+                rngdrv_generate(&ctx->crs, NULL, ctx->pool + tail, chunk, NULL);
+                ctx->pool_len += chunk;
+                mutex_unlock(&ctx->lock);
+
+                wake_up_interruptible(&ctx->wait);
+                cond_resched();
+        }
+}
+
+/* Lock a generator of a shared device, preferring the one of the current
+   CPU. If all are in use, wait for that one unless nowait is set. */
+static struct rngdrv_slot *rngdrv_slot_lock(struct rngdrv_dev *dev, bool nowait)
+{
+        unsigned int home = raw_smp_processor_id() % dev->n_slots;
+        struct rngdrv_slot *slot;
+        unsigned int i;
+
+        for (i = 0; i < dev->n_slots; ++i) {
+                slot = dev->slots[(home + i) % dev->n_slots];
+                if (mutex_trylock(&slot->lock)) {
+                        return slot;
+                }
+                if (!i) {
+                        this_cpu_inc(rngdrv_stats.slot_busy);
+                }
+        }
+
+        if (nowait) {
+                return ERR_PTR(-EAGAIN);
+        }
+        slot = dev->slots[home];
+        if (mutex_lock_interruptible(&slot->lock)) {
+                return ERR_PTR(-ERESTARTSYS);
+        }
+        return slot;
+}
+
+/* Move a locked generator of a shared device to byte pos of the sequence,
+   switching it to the configuration of the device first if a new one was
+   published. Out of memory, it keeps the configuration it has, if any. */
+static int rngdrv_slot_seek(struct rngdrv_dev *dev, struct rngdrv_slot *slot, uint64_t pos)
+{
+        struct rngdrv_cfg *cfg;
+
+        if (!slot->staging) {
+                slot->staging = kmalloc(STAGING_SIZE, GFP_KERNEL);
+                if (!slot->staging) {
+                        return -ENOMEM;
+                }
+        }
+
+        if (rcu_access_pointer(dev->cfg) != slot->cfg) {
+                cfg = rngdrv_cfg_get(dev);
+                if (crs_seed(&slot->crs, &cfg->crs)) {
+                        rngdrv_cfg_put(cfg);
+                        if (!slot->cfg) {
+                                return -ENOMEM;
+                        }
+                } else {
+                        if (slot->cfg) {
+                                rngdrv_cfg_put(slot->cfg);
+                        }
+                        slot->cfg = cfg;
+                }
+        }
+
+        crs_advance(&slot->crs, pos, slot->staging, STAGING_SIZE);
+        return 0;
+}
+
+/* Return true if a locked generator can move to byte pos of the sequence
+   without allocating, switching configuration or stepping over more than
+   STAGING_SIZE bytes, so that a nonblocking reader may take it there. */
+static bool rngdrv_slot_ready(struct rngdrv_dev *dev, struct rngdrv_slot *slot, uint64_t pos)
+{
+        return slot->staging && rcu_access_pointer(dev->cfg) == slot->cfg &&
+               pos >= slot->crs.pos && pos - slot->crs.pos <= STAGING_SIZE;
+}
+
+/* Lock a generator of a shared device that is ready at the first unclaimed
+   byte and claim count bytes there, returning their position in pos. If
+   none is, have the refresh work bring one to the sequence and fail with
+   -EAGAIN. Never sleeps. */
+static struct rngdrv_slot *rngdrv_slot_claim_nowait(struct rngdrv_dev *dev, size_t count,
+                                                    uint64_t *pos)
+{
+        unsigned int home = raw_smp_processor_id() % dev->n_slots;
+        struct rngdrv_slot *slot;
+        unsigned int i;
+        s64 old;
+
+        for (i = 0; i < dev->n_slots; ++i) {
+                slot = dev->slots[(home + i) % dev->n_slots];
+                if (!mutex_trylock(&slot->lock)) {
+                        if (!i) {
+                                this_cpu_inc(rngdrv_stats.slot_busy);
+                        }
+                        continue;
+                }
+
+                /* Claim only at a position the slot is ready for, so that a
+                   concurrent claim cannot leave it a long way behind. */
+                old = atomic64_read(&dev->pos);
+                while (rngdrv_slot_ready(dev, slot, old)) {
+                        if (atomic64_try_cmpxchg(&dev->pos, &old, old + count)) {
+                                *pos = old;
+                                return slot;
+                        }
+                }
+                mutex_unlock(&slot->lock);
+        }
+
+        queue_work(system_unbound_wq, &dev->refresh);
+        return ERR_PTR(-EAGAIN);
+}
+
+/* Bring a generator of a shared device to its first unclaimed byte, so that
+   the next nonblocking read finds one ready. */
+static void rngdrv_slots_refresh(struct work_struct *work)
+{
+        struct rngdrv_dev *dev = container_of(work, struct rngdrv_dev, refresh);
+        struct rngdrv_slot *slot;
+
+        slot = rngdrv_slot_lock(dev, false);
+        if (IS_ERR(slot)) {
+                return;
+        }
+        rngdrv_slot_seek(dev, slot, atomic64_read(&dev->pos));
+        mutex_unlock(&slot->lock);
+}
+
+/* Reads of a shared device claim iov_iter_count(to) bytes of its sequence
+   at once and return them, or as many as could be copied. The rest of the
+   claim is skipped. Nonblocking reads fail with -EAGAIN rather than seek a
+   generator, as the private path does when its pool is not ready. */
+static ssize_t rngdrv_shared_read(struct kiocb *iocb, struct iov_iter *to, u64 *gen_ns)
+{
+        struct rngdrv_file *ctx = iocb->ki_filp->private_data;
+        bool nowait = (iocb->ki_flags & IOCB_NOWAIT) || (iocb->ki_filp->f_flags & O_NONBLOCK);
+        size_t count = iov_iter_count(to);
+        struct rngdrv_slot *slot;
+        size_t chunk, copied;
+        ssize_t done;
+        uint64_t pos;
+        int ret;
+
+        if (!count) {
+                return 0;
+        }
+
+        if (nowait) {
+                slot = rngdrv_slot_claim_nowait(ctx->dev, count, &pos);
+        } else {
+                slot = rngdrv_slot_lock(ctx->dev, false);
+                pos = atomic64_fetch_add(count, &ctx->dev->pos);
+        }
+        if (IS_ERR(slot)) {
+                return PTR_ERR(slot);
+        }
+
+        ret = rngdrv_slot_seek(ctx->dev, slot, pos);
+        if (ret) {
+                done = ret;
+                goto out;
+        }
+
+        done = 0;
+        while (count) {
+                chunk = min_t(size_t, count, STAGING_SIZE);
+
+                rngdrv_generate(&slot->crs, NULL, slot->staging, chunk, gen_ns);
+
+                copied = copy_to_iter(slot->staging, chunk, to);
+                done += copied;
+                count -= chunk;
+
+                if (copied != chunk) {
+                        if (!done) {
+                                done = -EFAULT;
+                        }
+                        break;
+                }
+
+                if (count) {
+                        if (signal_pending(current)) {
+                                break;
+                        }
+                        cond_resched();
+                }
+        }
+
+out:
+        mutex_unlock(&slot->lock);
+        return done;
+}
+
+/* Claim len bytes of the sequence of a shared device and generate them into buf. */
+static int rngdrv_shared_fill(struct rngdrv_dev *dev, uint8_t *buf, size_t len)
+{
+        struct rngdrv_slot *slot;
+        int ret;
+
+        slot = rngdrv_slot_lock(dev, false);
+        if (IS_ERR(slot)) {
+                return PTR_ERR(slot);
+        }
+
+        ret = rngdrv_slot_seek(dev, slot, atomic64_fetch_add(len, &dev->pos));
+        if (!ret) {
+                rngdrv_generate(&slot->crs, NULL, buf, len, NULL);
+        }
+
+        mutex_unlock(&slot->lock);
+        return ret;
+}
+
+static void rngdrv_slots_free(struct rngdrv_dev *dev);
+
+/* Give a shared device its generators. */
+static int rngdrv_slots_create(struct rngdrv_dev *dev)
+{
+        struct rngdrv_slot *slot;
+        unsigned int i;
+
+        dev->n_slots = min_t(unsigned int, nr_cpu_ids, SLOTS_MAX);
+        dev->slots = kcalloc(dev->n_slots, sizeof(*dev->slots), GFP_KERNEL);
+        if (!dev->slots) {
+                return -ENOMEM;
+        }
+        INIT_WORK(&dev->refresh, rngdrv_slots_refresh);
+
+        for (i = 0; i < dev->n_slots; ++i) {
+                slot = kmem_cache_zalloc(slot_cache, GFP_KERNEL);
+                if (!slot) {
+                        rngdrv_slots_free(dev);
+                        return -ENOMEM;
+                }
+                crs_init(&slot->crs);
+                mutex_init(&slot->lock);
+                dev->slots[i] = slot;
+        }
+        return 0;
+}
+
+static void rngdrv_slots_free(struct rngdrv_dev *dev)
+{
+        struct rngdrv_slot *slot;
+        unsigned int i;
+
+        if (!dev->slots) {
+                return;
+        }
+
+        cancel_work_sync(&dev->refresh);
+        for (i = 0; i < dev->n_slots; ++i) {
+                slot = dev->slots[i];
+                if (!slot) {
+                        break;
+                }
+                crs_destroy(&slot->crs);
+                if (slot->cfg) {
+                        rngdrv_cfg_put(slot->cfg);
+                }
+                kfree(slot->staging);
+                mutex_destroy(&slot->lock);
+                kmem_cache_free(slot_cache, slot);
+        }
+        kfree(dev->slots);
+        dev->slots = NULL;
+}
+
+/* Return the state of a minor, allocating it on first use, or NULL. */
+static struct rngdrv_dev *rngdrv_dev_get(unsigned int minor)
+{
+        struct rngdrv_dev *dev;
+
+        /* Pairs with the release store below, so that a minor is seen
+           only once its configuration is set. */
+        dev = smp_load_acquire(&rngdrv_devs[minor]);
+        if (dev) {
+                return dev;
+        }
+
+        mutex_lock(&rngdrv_devs_lock);
+        dev = rngdrv_devs[minor];
+        if (!dev) {
+                dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+                if (dev && shared && rngdrv_slots_create(dev)) {
+                        kfree(dev);
+                        dev = NULL;
+                }
+                if (dev) {
+                        kref_get(&rngdrv_cfg_default->ref);
+                        RCU_INIT_POINTER(dev->cfg, rngdrv_cfg_default);
+                        smp_store_release(&rngdrv_devs[minor], dev);
+                }
+        }
+        mutex_unlock(&rngdrv_devs_lock);
+
+        return dev;
+}
+
 static int rngdrv_open(struct inode *inode, struct file *file)
 {
-        if (atomic_cmpxchg(&cdev_status, CDEV_NOT_USED, CDEV_EXCLUSIVE_OPEN)) {
-                return -EBUSY;
+        struct rngdrv_dev *dev;
+        struct rngdrv_file *ctx;
+
+        dev = rngdrv_dev_get(iminor(inode));
+        if (!dev) {
+                goto err;
+        }
+
+        ctx = kmem_cache_alloc(file_cache, GFP_KERNEL);
+        if (!ctx) {
+                goto err;
+        }
+
+        ctx->staging = kmalloc(STAGING_SIZE, GFP_KERNEL);
+        if (!ctx->staging) {
+                goto err_free_ctx;
         }
 
+        /* Shared devices have no per-file stream to prefill. */
+        ctx->pool = NULL;
+        if (pool_high && !shared) {
+                ctx->pool = kvmalloc(pool_high, GFP_KERNEL);
+                if (!ctx->pool) {
+                        goto err_free_staging;
+                }
+        }
+
+        ctx->ring = NULL;
+        ctx->ring_head = 0;
+        ctx->pool_head = 0;
+        ctx->pool_len = 0;
+        ctx->next_pos = 0;
+        mutex_init(&ctx->lock);
+        mutex_init(&ctx->ring_lock);
+        init_waitqueue_head(&ctx->wait);
+        INIT_WORK(&ctx->prefill, rngdrv_prefill);
+        ctx->dev = dev;
+        ctx->cfg = NULL;
+        ctx->seeded = false;
+        ctx->lanes = NULL;
+        crs_init(&ctx->crs);
+        /* Files of a shared device read through its slots, which hold the
+           configuration themselves. */
+        if (shared) {
+                stream_open(inode, file);
+        } else {
+                ctx->cfg = rngdrv_cfg_get(dev);
+                if (crs_seed(&ctx->crs, &ctx->cfg->crs)) {
+                        goto err_put_cfg;
+                }
+        }
+        file->private_data = ctx;
+        rngdrv_pool_kick(ctx);
+
         pr_info("Successfully opened a device\n");
         try_module_get(THIS_MODULE);
   
         return SUCCESS;
+
+err_put_cfg:
+        rngdrv_cfg_put(ctx->cfg);
+        kvfree(ctx->pool);
+err_free_staging:
+        kfree(ctx->staging);
+err_free_ctx:
+        kmem_cache_free(file_cache, ctx);
+err:
+        this_cpu_inc(rngdrv_stats.open_rejected);
+        return -ENOMEM;
 }
 
 static int rngdrv_release(struct inode *inode, struct file *file)
 {
-        atomic_set(&cdev_status, CDEV_NOT_USED);
+        struct rngdrv_file *ctx = file->private_data;
+
+        cancel_work_sync(&ctx->prefill);
+        rngdrv_lanes_free(ctx->lanes);
+        crs_destroy(&ctx->crs);
+        if (ctx->cfg) {
+                rngdrv_cfg_put(ctx->cfg);
+        }
+        mutex_destroy(&ctx->lock);
+        mutex_destroy(&ctx->ring_lock);
+        kvfree(ctx->pool);
+        vfree(ctx->ring);
+        kfree(ctx->staging);
+        kmem_cache_free(file_cache, ctx);
 
         module_put(THIS_MODULE);
         pr_info("Successfully closed a device\n");
@@ -95,89 +894,761 @@ static ssize_t rngdrv_write(struct file *file, const char __user *buffer, size_t
         return -EINVAL; 
 }
 
-static ssize_t rngdrv_read(struct file *file, char __user *buffer, size_t count, loff_t *offset)
+/* Reads are served from the pool first and generate the rest in place.
+   With O_NONBLOCK or IOCB_NOWAIT, only pooled bytes are returned, and
+   -EAGAIN if the file would first have to switch configuration or seek,
+   which may allocate and take long. Time spent generating is added to
+   gen_ns if it is not NULL. */
+static ssize_t rngdrv_do_read(struct kiocb *iocb, struct iov_iter *to, u64 *gen_ns)
+{
+        struct file *file = iocb->ki_filp;
+        struct rngdrv_file *ctx = file->private_data;
+        bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+        bool nonblock = (nowait || (file->f_flags & O_NONBLOCK)) && ctx->pool;
+        size_t count = iov_iter_count(to);
+        loff_t *offset = &iocb->ki_pos;
+        size_t chunk, copied;
+        ssize_t done;
+
+        if (shared) {
+                return rngdrv_shared_read(iocb, to, gen_ns);
+        }
+
+        if (!count) {
+                return 0;
+        }
+
+        if (*offset < 0) {
+                return -EINVAL;
+        }
+
+        if (nonblock || nowait) {
+                if (!mutex_trylock(&ctx->lock)) {
+                        return -EAGAIN;
+                }
+        } else if (mutex_lock_interruptible(&ctx->lock)) {
+                return -ERESTARTSYS;
+        }
+
+        /* The file offset is the index into the sequence. It differs from
+           the start of the pool after pread, or after a short copy. Lanes
+           only run forward and have no pool. */
+        if (ctx->lanes) {
+                nonblock = false;
+        } else if (nonblock || nowait) {
+                /* Left to the prefill worker, which moves the pool to
+                   next_pos, set to *offset below, and wakes pollers. */
+                if (!rngdrv_pool_ready(ctx, *offset)) {
+                        done = -EAGAIN;
+                        goto out;
+                }
+        } else {
+                rngdrv_pool_sync(ctx, *offset);
+        }
+
+        done = 0;
+        while (count && ctx->pool_len) {
+                chunk = min3(count, ctx->pool_len, pool_high - ctx->pool_head);
+                copied = copy_to_iter(ctx->pool + ctx->pool_head, chunk, to);
+                rngdrv_pool_consume(ctx, copied);
+                done += copied;
+                count -= copied;
+
+                if (copied != chunk) {
+                        if (!done) {
+                                done = -EFAULT;
+                        }
+                        goto out;
+                }
+        }
+
+        if (nonblock) {
+                if (!done) {
+                        done = -EAGAIN;
+                }
+                goto out;
+        }
+
+        while (count) {
+                chunk = min_t(size_t, count, STAGING_SIZE);
+
+                rngdrv_generate(&ctx->crs, ctx->lanes, ctx->staging, chunk, gen_ns);
+
+                copied = copy_to_iter(ctx->staging, chunk, to);
+                done += copied;
+                count -= chunk;
+
+                if (copied != chunk) {
+                        /* Report a fault only if nothing has been copied. */
+                        if (!done) {
+                                done = -EFAULT;
+                        }
+                        break;
+                }
+
+                /* Large reads must stay preemptible and interruptible. */
+                if (count) {
+                        if (signal_pending(current)) {
+                                break;
+                        }
+                        cond_resched();
+                }
+        }
+
+out:
+        if (done > 0) {
+                *offset += done;
+        }
+
+        if (!ctx->lanes) {
+                ctx->next_pos = *offset;
+                if (!rngdrv_pool_ready(ctx, ctx->next_pos) && ctx->pool) {
+                        queue_work(system_unbound_wq, &ctx->prefill);
+                }
+        }
+        rngdrv_pool_kick(ctx);
+        mutex_unlock(&ctx->lock);
+
+        return done;
+}
+
+/* Also backs read(2), readv(2), io_uring reads and, through
+   copy_splice_read, splice(2) and sendfile(2). */
+static ssize_t rngdrv_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+        size_t count = iov_iter_count(to);
+        u64 start, gen_ns = 0;
+        ssize_t ret;
+
+        trace_rngdrv_read_enter(count, iocb->ki_pos);
+        start = ktime_get_ns();
+
+        /* Only time generation when someone is listening. */
+        ret = rngdrv_do_read(iocb, to, trace_rngdrv_read_exit_enabled() ? &gen_ns : NULL);
+
+        rngdrv_stats_read(ret, ktime_get_ns() - start);
+        trace_rngdrv_read_exit(count, ret, gen_ns);
+
+        return ret;
+}
+
+/* Readable while the pool holds bytes a nonblocking read at next_pos
+   would return. Files without a pool, or in lanes mode, are always
+   readable. */
+static __poll_t rngdrv_poll(struct file *file, poll_table *wait)
+{
+        struct rngdrv_file *ctx = file->private_data;
+
+        poll_wait(file, &ctx->wait, wait);
+
+        if (!ctx->pool || READ_ONCE(ctx->lanes) ||
+            (READ_ONCE(ctx->pool_len) && rngdrv_pool_ready(ctx, READ_ONCE(ctx->next_pos)))) {
+                return EPOLLIN | EPOLLRDNORM;
+        }
+
+        queue_work(system_unbound_wq, &ctx->prefill);
+        return 0;
+}
+
+/* The stream has no end, so only SEEK_SET and SEEK_CUR are supported.
+   Files of shared devices and files in lanes mode have no position of
+   their own. */
+static loff_t rngdrv_llseek(struct file *file, loff_t offset, int whence)
+{
+        struct rngdrv_file *ctx = file->private_data;
+        loff_t pos;
+
+        if (shared) {
+                return -ESPIPE;
+        }
+
+        switch (whence) {
+        case SEEK_SET:
+                pos = offset;
+                break;
+        case SEEK_CUR:
+                if (check_add_overflow(file->f_pos, offset, &pos)) {
+                        return -EOVERFLOW;
+                }
+                break;
+        default:
+                return -EINVAL;
+        }
+
+        if (pos < 0) {
+                return -EINVAL;
+        }
+
+        if (mutex_lock_interruptible(&ctx->lock)) {
+                return -ERESTARTSYS;
+        }
+
+        if (ctx->lanes) {
+                pos = -ESPIPE;
+        } else {
+                rngdrv_pool_sync(ctx, pos);
+                file->f_pos = pos;
+                ctx->next_pos = pos;
+        }
+
+        mutex_unlock(&ctx->lock);
+
+        return pos;
+}
+
+/* Fill the free space of the ring with the next bytes of the file's stream
+   and return how many were added. Called with ctx->lock held. */
+static long rngdrv_ring_fill(struct file *file, struct rngdrv_file *ctx)
+{
+        uint8_t *data = (uint8_t *)ctx->ring + PAGE_SIZE;
+        uint64_t head = ctx->ring_head;
+        uint64_t tail, used;
+        size_t off, chunk, taken;
+        long added = 0;
+        int ret = 0;
+
+        /* Pairs with the consumer's release store, so that bytes are not
+           overwritten before it is done with them. */
+        tail = smp_load_acquire(&ctx->ring->tail);
+        used = head - tail;
+        if (used > RNGDRV_RING_SIZE) {
+                return -EINVAL;
+        }
+
+        if (!shared && !ctx->lanes) {
+                rngdrv_pool_sync(ctx, file->f_pos);
+        }
+
+        while (used < RNGDRV_RING_SIZE) {
+                off = head & (RNGDRV_RING_SIZE - 1);
+                chunk = min_t(size_t, RNGDRV_RING_SIZE - used, RNGDRV_RING_SIZE - off);
+                if (shared) {
+                        ret = rngdrv_shared_fill(ctx->dev, data + off, chunk);
+                        if (ret) {
+                                break;
+                        }
+                } else {
+                        taken = rngdrv_pool_take(ctx, data + off, chunk);
+                        rngdrv_generate(&ctx->crs, ctx->lanes, data + off + taken, chunk - taken, NULL);
+                }
+                head += chunk;
+                used += chunk;
+                added += chunk;
+        }
+
+        if (!added && ret) {
+                return ret;
+        }
+
+        ctx->ring_head = head;
+        file->f_pos += added;
+        ctx->next_pos = file->f_pos;
+        /* Publish the bytes before the new head. */
+        smp_store_release(&ctx->ring->head, head);
+        rngdrv_pool_kick(ctx);
+
+        return added;
+}
+
+/* Map the ring, creating it empty on the first call. ->mmap runs with the
+   mm locked for writing, while readers hold ctx->lock and the slot locks
+   across copies that may fault, so neither is taken here and the ring is
+   only filled by RNGDRV_IOC_RING_FILL. */
+static int rngdrv_mmap(struct file *file, struct vm_area_struct *vma)
 {
-        GF_elem_t *next_val;
-        size_t i;
-        uint8_t retval;
-        
-        retval = 0;
+        struct rngdrv_file *ctx = file->private_data;
+        struct rngdrv_ring_ctl *ring;
+        int ret;
 
-        next_val = GF_elem_cpy(crs_gf_const);
-        
-        for (i = 0; i < crs_ord; i++) {
-                GF_elem_prod(prod, crs_gf_coeffs[i], crs_gf_vals[i]);
-                GF_elem_sum(acc_sum, acc_sum, prod);
-                memset(prod->poly->coeff, 0, prod->GF->I->deg * sizeof(prod->poly->coeff[0]));
-                prod->poly->deg = 0;
+        if (vma->vm_pgoff || vma->vm_end - vma->vm_start != RING_MAP_SIZE) {
+                return -EINVAL;
         }
-        
-        GF_elem_sum(next_val, next_val, acc_sum);
 
-        memset(acc_sum->poly->coeff, 0, acc_sum->GF->I->deg * sizeof(acc_sum->poly->coeff[0]));
-        acc_sum->poly->deg = 0;
+        mutex_lock(&ctx->ring_lock);
+        ring = ctx->ring;
+        if (!ring) {
+                ring = vmalloc_user(RING_MAP_SIZE);
+                if (!ring) {
+                        ret = -ENOMEM;
+                        goto out;
+                }
+                ring->size = RNGDRV_RING_SIZE;
+                /* Pairs with the acquire in RNGDRV_IOC_RING_FILL. */
+                smp_store_release(&ctx->ring, ring);
+        }
+
+        ret = remap_vmalloc_range(vma, ring, 0);
+
+out:
+        mutex_unlock(&ctx->ring_lock);
+        return ret;
+}
+
+static long rngdrv_set_config(struct rngdrv_dev *dev, const struct rngdrv_config __user *uarg)
+{
+        struct rngdrv_config *arg;
+        struct rngdrv_cfg *cfg;
+        GF_t *GF;
 
-        GF_elem_destroy(crs_gf_vals[0]);
+        if (!capable(CAP_SYS_ADMIN)) {
+                return -EPERM;
+        }
 
-        memmove(crs_gf_vals, crs_gf_vals + 1, (crs_ord - 1) * sizeof(GF_elem_t *));
+        arg = memdup_user(uarg, sizeof(*arg));
+        if (IS_ERR(arg)) {
+                return PTR_ERR(arg);
+        }
 
-        crs_gf_vals[crs_ord - 1] = next_val;
+        GF = rngdrv_field(arg->width);
+        if (!GF || arg->ord > RNGDRV_MAX_ORD) {
+                kfree(arg);
+                return -EINVAL;
+        }
 
-        retval = GF_elem_to_uint8(next_val);
-        
-        if (copy_to_user(buffer, &retval, sizeof(retval))) {
-                pr_err("Error copying data to user.\n");
+        /* All the work, including the jump and block tables, happens
+           here, before anyone can see the new configuration. */
+        cfg = rngdrv_cfg_create(GF, arg->ord, arg->coeffs, arg->vals, arg->cnst);
+        kfree(arg);
+        if (IS_ERR(cfg)) {
+                return PTR_ERR(cfg);
         }
 
-        return 1;
+        rngdrv_cfg_publish(dev, cfg);
+        return 0;
+}
+
+static long rngdrv_set_sparse_config(struct rngdrv_dev *dev,
+                                     const struct rngdrv_sparse_config __user *uarg)
+{
+        struct rngdrv_sparse_config arg;
+        struct rngdrv_cfg *cfg;
+        struct crs_tap *taps;
+        uint32_t *vals;
+        GF_t *GF;
+
+        if (!capable(CAP_SYS_ADMIN)) {
+                return -EPERM;
+        }
+
+        if (copy_from_user(&arg, uarg, sizeof(arg))) {
+                return -EFAULT;
+        }
+
+        GF = rngdrv_field(arg.width);
+        if (!GF || !arg.ord || arg.ord > RNGDRV_MAX_SPARSE_ORD || arg.n_taps > arg.ord ||
+            arg.n_taps > RNGDRV_MAX_SPARSE_TAPS) {
+                return -EINVAL;
+        }
+
+        taps = vmemdup_user(u64_to_user_ptr(arg.taps), array_size(arg.n_taps, sizeof(*taps)));
+        if (IS_ERR(taps)) {
+                return PTR_ERR(taps);
+        }
+
+        vals = vmemdup_user(u64_to_user_ptr(arg.vals), array_size(arg.ord, sizeof(*vals)));
+        if (IS_ERR(vals)) {
+                kvfree(taps);
+                return PTR_ERR(vals);
+        }
+
+        cfg = rngdrv_cfg_create_sparse(GF, arg.ord, taps, arg.n_taps, vals, arg.cnst);
+        kvfree(vals);
+        kvfree(taps);
+        if (IS_ERR(cfg)) {
+                return PTR_ERR(cfg);
+        }
+
+        rngdrv_cfg_publish(dev, cfg);
+        return 0;
+}
+
+/* Restart the file at offset 0 on cfg, taking over the caller's reference,
+   with the output of lanes instead of its own generator if lanes is not
+   NULL. With seeded set, the file then keeps cfg when the device changes
+   its configuration. On failure, cfg
+   and lanes are dropped and the file stays as it was. */
+static long rngdrv_restart(struct file *file, struct rngdrv_file *ctx, struct rngdrv_cfg *cfg,
+                           struct crs_lanes *lanes, bool seeded)
+{
+        struct crs_lanes *old;
+        long ret;
+
+        if (mutex_lock_interruptible(&ctx->lock)) {
+                rngdrv_cfg_put(cfg);
+                rngdrv_lanes_free(lanes);
+                return -ERESTARTSYS;
+        }
+
+        ret = rngdrv_cfg_switch(ctx, cfg, 0);
+        if (ret) {
+                old = lanes;
+        } else {
+                old = ctx->lanes;
+                ctx->lanes = lanes;
+                ctx->seeded = seeded;
+                file->f_pos = 0;
+                ctx->next_pos = 0;
+        }
+
+        mutex_unlock(&ctx->lock);
+        rngdrv_lanes_free(old);
+        return ret;
+}
+
+static long rngdrv_reseed(struct file *file, struct rngdrv_file *ctx,
+                          const struct rngdrv_seed __user *uarg)
+{
+        struct rngdrv_seed *arg;
+        struct rngdrv_cfg *cur, *cfg;
+        struct crs_cfg *c;
+
+        /* A file of a shared device has no stream of its own to restart. */
+        if (shared) {
+                return -EINVAL;
+        }
+
+        cur = rngdrv_cfg_get(ctx->dev);
+        if (!uarg) {
+                cfg = cur;
+        } else {
+                /* The seed only has room for RNGDRV_MAX_ORD values. */
+                c = &cur->crs;
+                if (c->ord > RNGDRV_MAX_ORD) {
+                        rngdrv_cfg_put(cur);
+                        return -EINVAL;
+                }
+
+                arg = memdup_user(uarg, sizeof(*arg));
+                if (IS_ERR(arg)) {
+                        rngdrv_cfg_put(cur);
+                        return PTR_ERR(arg);
+                }
+
+                cfg = rngdrv_cfg_create_sparse(c->GF, c->ord, c->taps, c->n_taps, arg->vals, c->cnst);
+                kfree(arg);
+                rngdrv_cfg_put(cur);
+                if (IS_ERR(cfg)) {
+                        return PTR_ERR(cfg);
+                }
+        }
+
+        return rngdrv_restart(file, ctx, cfg, NULL, uarg != NULL);
+}
+
+static long rngdrv_set_lanes(struct file *file, struct rngdrv_file *ctx,
+                             const struct rngdrv_lanes_config __user *uarg)
+{
+        struct rngdrv_lanes_config arg;
+        struct crs_lanes *lanes;
+        struct rngdrv_cfg *cfg;
+        uint32_t *vals;
+        size_t n_vals;
+        int ret;
+
+        /* A file of a shared device has no stream of its own to restart. */
+        if (shared) {
+                return -EINVAL;
+        }
+
+        if (copy_from_user(&arg, uarg, sizeof(arg))) {
+                return -EFAULT;
+        }
+
+        cfg = rngdrv_cfg_get(ctx->dev);
+        if (!arg.n_lanes) {
+                return rngdrv_restart(file, ctx, cfg, NULL, false);
+        }
+
+        n_vals = array_size(arg.n_lanes, cfg->crs.ord);
+        if (arg.n_lanes > RNGDRV_MAX_LANES || n_vals > RNGDRV_MAX_LANE_VALS) {
+                rngdrv_cfg_put(cfg);
+                return -EINVAL;
+        }
+
+        vals = vmemdup_user(u64_to_user_ptr(arg.vals), array_size(n_vals, sizeof(*vals)));
+        if (IS_ERR(vals)) {
+                rngdrv_cfg_put(cfg);
+                return PTR_ERR(vals);
+        }
+
+        /* The lanes share the tables of cfg, which the file holds on to. */
+        lanes = kmalloc(sizeof(*lanes), GFP_KERNEL);
+        ret = lanes ? crs_lanes_init(lanes, &cfg->crs, arg.n_lanes, arg.block, vals) : -ENOMEM;
+        kvfree(vals);
+        if (ret) {
+                kfree(lanes);
+                rngdrv_cfg_put(cfg);
+                return ret;
+        }
+
+        return rngdrv_restart(file, ctx, cfg, lanes, true);
+}
+
+static long rngdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+        struct rngdrv_file *ctx = file->private_data;
+        long ret;
+
+        switch (cmd) {
+        case RNGDRV_IOC_SET_CONFIG:
+                return rngdrv_set_config(ctx->dev, (const struct rngdrv_config __user *)arg);
+        case RNGDRV_IOC_SET_SPARSE_CONFIG:
+                return rngdrv_set_sparse_config(ctx->dev,
+                                                (const struct rngdrv_sparse_config __user *)arg);
+        case RNGDRV_IOC_RESEED:
+                return rngdrv_reseed(file, ctx, (const struct rngdrv_seed __user *)arg);
+        case RNGDRV_IOC_SET_LANES:
+                return rngdrv_set_lanes(file, ctx, (const struct rngdrv_lanes_config __user *)arg);
+        case RNGDRV_IOC_RING_FILL:
+                if (mutex_lock_interruptible(&ctx->lock)) {
+                        return -ERESTARTSYS;
+                }
+                ret = smp_load_acquire(&ctx->ring) ? rngdrv_ring_fill(file, ctx) : -ENXIO;
+                mutex_unlock(&ctx->lock);
+                return ret;
+        default:
+                return -ENOTTY;
+        }
+}
+
+/* Sum of a statistics field over all CPUs. */
+#define rngdrv_stats_sum(field) ({                                      \
+        u64 __sum = 0;                                                  \
+        int __cpu;                                                      \
+        for_each_possible_cpu(__cpu)                                    \
+                __sum += per_cpu_ptr(&rngdrv_stats, __cpu)->field;      \
+        __sum;                                                          \
+})
+
+static int stats_show(struct seq_file *m, void *v)
+{
+        u64 reads = rngdrv_stats_sum(reads);
+        u64 read_bytes = rngdrv_stats_sum(read_bytes);
+
+        seq_printf(m, "generated %llu\n", rngdrv_stats_sum(generated));
+        seq_printf(m, "reads %llu\n", reads);
+        seq_printf(m, "read_bytes %llu\n", read_bytes);
+        seq_printf(m, "bytes_per_read %llu\n", reads ? div64_u64(read_bytes, reads) : 0);
+        seq_printf(m, "read_busy %llu\n", rngdrv_stats_sum(read_busy));
+        seq_printf(m, "slot_busy %llu\n", rngdrv_stats_sum(slot_busy));
+        seq_printf(m, "open_rejected %llu\n", rngdrv_stats_sum(open_rejected));
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(stats);
+
+/* Latency of reads as a log2 histogram: lower bound in ns and count of
+   each nonempty bucket. */
+static int read_latency_show(struct seq_file *m, void *v)
+{
+        u64 count;
+        int k;
+
+        for (k = 0; k < READ_NS_BUCKETS; ++k) {
+                count = rngdrv_stats_sum(read_ns[k]);
+                if (count) {
+                        seq_printf(m, "%llu %llu\n", 1ULL << k, count);
+                }
+        }
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(read_latency);
+
+/* Build the recurrence given by the parameters. Initial values past the
+   end of crs_vals are zero. */
+static struct rngdrv_cfg *rngdrv_cfg_load(GF_t *GF)
+{
+        struct rngdrv_cfg *cfg;
+        struct crs_tap *taps;
+        uint32_t *vals;
+        size_t k, n_taps = crs_taps_count / 2;
+
+        if (!crs_taps_count) {
+                return rngdrv_cfg_create(GF, crs_ord, crs_coeffs, crs_vals, crs_const);
+        }
+        if (n_taps > RNGDRV_MAX_SPARSE_TAPS) {
+                return ERR_PTR(-EINVAL);
+        }
+
+        taps = kvmalloc_array(n_taps, sizeof(*taps), GFP_KERNEL);
+        vals = kvcalloc(crs_ord, sizeof(*vals), GFP_KERNEL);
+        if (!taps || !vals) {
+                cfg = ERR_PTR(-ENOMEM);
+                goto out;
+        }
+
+        for (k = 0; k < n_taps; ++k) {
+                taps[k].idx = crs_taps[2 * k];
+                taps[k].coeff = crs_taps[2 * k + 1];
+        }
+        memcpy(vals, crs_vals, min_t(size_t, crs_ord, MAX_LENGTH) * sizeof(*vals));
+
+        cfg = rngdrv_cfg_create_sparse(GF, crs_ord, taps, n_taps, vals, crs_const);
+
+out:
+        kvfree(vals);
+        kvfree(taps);
+        return cfg;
+}
+
+/* Drop the state of every minor that was opened. */
+static void rngdrv_devs_free(void)
+{
+        unsigned int i;
+
+        for (i = 0; i < minors; ++i) {
+                if (rngdrv_devs[i]) {
+                        rngdrv_slots_free(rngdrv_devs[i]);
+                        rngdrv_cfg_put(rcu_replace_pointer(rngdrv_devs[i]->cfg, NULL, true));
+                        kfree(rngdrv_devs[i]);
+                        rngdrv_devs[i] = NULL;
+                }
+        }
+}
+
+static void rngdrv_devices_destroy(unsigned int count)
+{
+        while (count--) {
+                device_destroy(cls, MKDEV(MAJOR(rngdrv_devt), count));
+        }
 }
 
 static int __init rngdrv_init(void)
 {
-        size_t i;
-        
-        /* Register and create the device dynamically. */
-        major = register_chrdev(0, DEVICE_NAME, &fops);
-        if (major < 0) {
-                pr_alert("Failed to initialize a device with major %d\n", major);
-                return major;
+        struct device *device;
+        unsigned int i;
+        GF_t *GF;
+        int ret;
+
+        if (crs_taps_count % 2) {
+                pr_alert("CRS taps must be index,coefficient pairs\n");
+                return -EINVAL;
         }
-        pr_info("Successfully initialized a device with major %d\n", major);
 
-        cls = class_create(DEVICE_NAME);
-        device_create(cls, NULL, MKDEV(major, 0), NULL, DEVICE_NAME);
-        pr_info("Device is created at /dev/%s\n", DEVICE_NAME);
+        if (!crs_ord || crs_ord > (crs_taps_count ? CRS_MAX_ORD : MAX_LENGTH)) {
+                pr_alert("CRS order must be in range [1, %d], or [1, %d] with crs_taps\n",
+                         MAX_LENGTH, CRS_MAX_ORD);
+                return -EINVAL;
+        }
+
+        if (pool_high > POOL_MAX || pool_low > pool_high) {
+                pr_alert("Prefill watermarks must satisfy pool_low <= pool_high <= %d\n", POOL_MAX);
+                return -EINVAL;
+        }
+
+        if (!minors || minors > MINORS_MAX) {
+                pr_alert("Number of minors must be in range [1, %d]\n", MINORS_MAX);
+                return -EINVAL;
+        }
+
+        GF = rngdrv_field(crs_width);
+        if (!GF) {
+                pr_alert("CRS width must be 8, 16 or 32\n");
+                return -EINVAL;
+        }
 
         /* Set initial elements of CRS. */
-        crs_gf_const = GF_elem_from_uint8(crs_const);
-        acc_sum = GF_elem_get_neutral(&GF2_8);
-        prod = GF_elem_get_neutral(&GF2_8);
+        GF_init_tables();
+        rngdrv_cfg_default = rngdrv_cfg_load(GF);
+        if (IS_ERR(rngdrv_cfg_default)) {
+                ret = PTR_ERR(rngdrv_cfg_default);
+                if (ret == -EINVAL) {
+                        pr_alert("CRS coefficients, values and constant must fit in %u bits, "
+                                 "and at most %d taps be listed by increasing index below crs_ord\n",
+                                 crs_width, RNGDRV_MAX_SPARSE_TAPS);
+                } else {
+                        pr_alert("Failed to set up the CRS: %pe\n", rngdrv_cfg_default);
+                }
+                return ret;
+        }
+
+        file_cache = kmem_cache_create(DEVICE_NAME, sizeof(struct rngdrv_file), 0,
+                                       SLAB_HWCACHE_ALIGN, NULL);
+        if (!file_cache) {
+                ret = -ENOMEM;
+                goto err_put_cfg;
+        }
 
-        for (i = 0; i < crs_ord; ++i) {
-                crs_gf_coeffs[i] = GF_elem_from_uint8(crs_coeffs[i]);
-                crs_gf_vals[i] = GF_elem_from_uint8(crs_vals[i]);
+        if (shared) {
+                slot_cache = kmem_cache_create(DEVICE_NAME "_slot", sizeof(struct rngdrv_slot), 0,
+                                               SLAB_HWCACHE_ALIGN, NULL);
+                if (!slot_cache) {
+                        ret = -ENOMEM;
+                        goto err_destroy_file_cache;
+                }
         }
 
+        /* Register the minors and create their devices dynamically. */
+        ret = alloc_chrdev_region(&rngdrv_devt, 0, minors, DEVICE_NAME);
+        if (ret) {
+                pr_alert("Failed to allocate %u minors\n", minors);
+                goto err_destroy_slot_cache;
+        }
+
+        cdev_init(&rngdrv_cdev, &fops);
+        rngdrv_cdev.owner = THIS_MODULE;
+        ret = cdev_add(&rngdrv_cdev, rngdrv_devt, minors);
+        if (ret) {
+                goto err_unregister;
+        }
+        pr_info("Successfully initialized a device with major %d\n", MAJOR(rngdrv_devt));
+
+        cls = class_create(DEVICE_NAME);
+        if (IS_ERR(cls)) {
+                ret = PTR_ERR(cls);
+                goto err_del_cdev;
+        }
+
+        for (i = 0; i < minors; ++i) {
+                device = device_create(cls, NULL, MKDEV(MAJOR(rngdrv_devt), i), NULL,
+                                       DEVICE_NAME "%u", i);
+                if (IS_ERR(device)) {
+                        ret = PTR_ERR(device);
+                        rngdrv_devices_destroy(i);
+                        goto err_destroy_class;
+                }
+        }
+        pr_info("Devices are created at /dev/%s0 to /dev/%s%u\n", DEVICE_NAME, DEVICE_NAME,
+                minors - 1);
+
+        debugfs_dir = debugfs_create_dir(DEVICE_NAME, NULL);
+        debugfs_create_file("stats", 0444, debugfs_dir, NULL, &stats_fops);
+        debugfs_create_file("read_latency", 0444, debugfs_dir, NULL, &read_latency_fops);
+
         return SUCCESS;
+
+err_destroy_class:
+        class_destroy(cls);
+err_del_cdev:
+        cdev_del(&rngdrv_cdev);
+err_unregister:
+        unregister_chrdev_region(rngdrv_devt, minors);
+err_destroy_slot_cache:
+        kmem_cache_destroy(slot_cache);
+err_destroy_file_cache:
+        kmem_cache_destroy(file_cache);
+err_put_cfg:
+        rngdrv_cfg_put(rngdrv_cfg_default);
+        rcu_barrier();
+        return ret;
 }
 
 static void __exit rngdrv_cleanup(void)
 {       
-        size_t i;
+        debugfs_remove_recursive(debugfs_dir);
 
-        /* Destroy elements of CRS. */
-        GF_elem_destroy(crs_gf_const);
-        GF_elem_destroy(acc_sum);
-        GF_elem_destroy(prod);
+        rngdrv_devices_destroy(minors);
+        class_destroy(cls);
+        cdev_del(&rngdrv_cdev);
+        unregister_chrdev_region(rngdrv_devt, minors);
 
-        for (i = 0; i < crs_ord; ++i) {
-                GF_elem_destroy(crs_gf_coeffs[i]);
-                GF_elem_destroy(crs_gf_vals[i]);
-        }
+        kmem_cache_destroy(file_cache);
 
-        device_destroy(cls, MKDEV(major, 0));
-        class_destroy(cls);
-        unregister_chrdev(major, DEVICE_NAME);
+        /* Every file is closed, so these are the last references. Wait for
+           configurations still queued for freeing. */
+        rngdrv_devs_free();
+        kmem_cache_destroy(slot_cache);
+        rngdrv_cfg_put(rngdrv_cfg_default);
+        rcu_barrier();
         pr_info("Successfully unregistered and destroyed a device\n");
 
         return;
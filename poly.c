@@ -5,29 +5,77 @@
 
 #include "utils.h"
 
-poly_t *poly_from_array(uint8_t deg, uint8_t *coeff) {
+// Largest characteristic with lookup tables, such that the product of two
+// residues still fits in uint8_t.
+#define POLY_MODP_MAX 16
+
+// Arithmetic mod a small prime p.
+typedef struct {
+  uint8_t lazy;                 // Products of two residues that can be added to a
+                                // residue without overflowing uint8_t. 0 until built.
+  uint8_t red[256];             // red[x] = x mod p.
+  uint8_t neg[POLY_MODP_MAX];   // neg[x] = -x mod p.
+  uint8_t inv[POLY_MODP_MAX];   // inv[x] = x^-1 mod p, inv[0] = 0.
+} modp_t;
+
+static modp_t poly_modp[POLY_MODP_MAX + 1];
+
+void poly_init_tables(void) {
+  for (size_t p = 2; p <= POLY_MODP_MAX; ++p) {
+    modp_t *F = &poly_modp[p];
+    bool prime = true;
+    for (size_t d = 2; d * d <= p; ++d) {
+      prime = prime && (p % d);
+    }
+    if (!prime || F->lazy) {
+      continue;
+    }
+    for (size_t x = 0; x < 256; ++x) {
+      F->red[x] = x % p;
+    }
+    for (size_t x = 0; x < p; ++x) {
+      F->neg[x] = complement(x, p);
+      F->inv[x] = x ? inverse(x, p) : 0;
+    }
+    F->lazy = (255 - (p - 1)) / ((p - 1) * (p - 1));
+  }
+}
+
+// Return the tables of Fp, or NULL if coefficients must be reduced with %.
+static inline const modp_t *poly_modp_get(uint8_t p) {
+  if ((p > POLY_MODP_MAX) || !poly_modp[p].lazy) {
+    return NULL;
+  }
+  return &poly_modp[p];
+}
+
+// Allocate a polynomial with room for len coefficients right after it,
+// so that reaching them takes no further allocation or pointer chase.
+static poly_t *poly_alloc(size_t len) {
+  poly_t *res = xkmalloc(sizeof(*res) + len);
+  if (res) {
+    res->coeff = (uint8_t *)(res + 1);
+  }
+  return res;
+}
+
+poly_t *poly_from_array(uint16_t deg, uint8_t *coeff) {
   if (!coeff) {
     return NULL;
   }
   // Assume deg < len(coeff).
-  poly_t *poly = xkmalloc(sizeof(*poly));
-  uint8_t *tmp = xkmalloc(sizeof(*coeff) * (deg + 1));
-  if (!poly || !tmp) {
-    kfree(poly);
-    kfree(tmp);
+  poly_t *poly = poly_alloc(deg + 1);
+  if (!poly) {
     return NULL;
   }
   poly->deg = deg;
-  memcpy(tmp, coeff, sizeof(*coeff) * (deg + 1));
-  poly->coeff = tmp;
+  memcpy(poly->coeff, coeff, sizeof(*coeff) * (deg + 1));
   return poly;
 }
 
 void poly_destroy(poly_t *poly) {
-  if (poly) {
-    kfree(poly->coeff);
-    kfree(poly);
-  }
+  // The coefficients are in the same block.
+  kfree(poly);
 }
 
 bool poly_eq(const poly_t *a, const poly_t *b) {
@@ -41,18 +89,41 @@ poly_t *poly_create_zero(size_t len) {
   if (!len) {
     return NULL;
   }
-  poly_t *res = xkmalloc(sizeof(*res));
-  uint8_t *tmp = xkmalloc(sizeof(*tmp) * len);
-  if (!res || !tmp) {
-    kfree(res);
-    kfree(tmp);
+  poly_t *res = poly_alloc(len);
+  if (!res) {
     return NULL;
   }
   res->deg = 0;
-  res->coeff = memset(tmp, 0, sizeof(*tmp) * len);
+  memset(res->coeff, 0, sizeof(*res->coeff) * len);
   return res;
 }
 
+poly_t *poly_create_scratch(arena_t *scratch, size_t len) {
+  if (!scratch) {
+    return poly_create_zero(len);
+  }
+  if (!len) {
+    return NULL;
+  }
+  poly_t *res = arena_alloc(scratch, sizeof(*res) + len);
+  if (!res) {
+    return NULL;
+  }
+  res->coeff = (uint8_t *)(res + 1);
+  return res;
+}
+
+size_t poly_fpowm_scratch_size(uint16_t deg) {
+  // Three polynomials of length 2 * deg, each padded for alignment, and
+  // the temporaries of their products.
+  return 3 * (sizeof(poly_t) + 2 * (size_t)deg + sizeof(void *)) + poly_mul_scratch_size(deg);
+}
+
+size_t poly_inverse_scratch_size(uint16_t deg) {
+  // Four polynomials of length 2 * deg, each padded for alignment.
+  return 4 * (sizeof(poly_t) + 2 * (size_t)deg + sizeof(void *));
+}
+
 void poly_normalize_deg(poly_t *a) {
   if (!a) {
     return;
@@ -67,6 +138,7 @@ void poly_sum(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
   if (!res) {
     return;
   }
+  const modp_t *F = poly_modp_get(p);
   // Using tmp variable w allows a or b to be passed as res.
   uint8_t w;
   size_t max_deg = MAX(a->deg, b->deg);
@@ -78,12 +150,64 @@ void poly_sum(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
     if (i <= b->deg) {
       w += b->coeff[i];
     }
-    res->coeff[i] = w % p;
+    res->coeff[i] = F ? F->red[w] : w % p;
   }
   res->deg = max_deg;
   poly_normalize_deg(res);
 }
 
+// Set res = a - b, where a and b are polynomials over Fp.
+void poly_diff(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
+  if (!res) {
+    return;
+  }
+  const modp_t *F = poly_modp_get(p);
+  // Using tmp variable w allows a or b to be passed as res.
+  uint8_t w;
+  size_t max_deg = MAX(a->deg, b->deg);
+  for (size_t i = 0; i <= max_deg; ++i) {
+    w = 0;
+    if (i <= a->deg) {
+      w += a->coeff[i];
+    }
+    if (i <= b->deg) {
+      w += F ? F->neg[b->coeff[i]] : complement(b->coeff[i], p);
+    }
+    res->coeff[i] = F ? F->red[w] : w % p;
+  }
+  res->deg = max_deg;
+  poly_normalize_deg(res);
+}
+
+static inline void poly_reduce(uint8_t *u, size_t len, const modp_t *F) {
+  for (size_t i = 0; i < len; ++i) {
+    u[i] = F->red[u[i]];
+  }
+}
+
+// Set u = u mod v in place, for deg(u) = n >= deg(v) = m. Each step adds
+// -q * v to u, and the sums are reduced only every F->lazy steps.
+static void poly_div_lazy(uint8_t *u, size_t n, const uint8_t *v, size_t m, const modp_t *F) {
+  uint8_t lead = F->inv[v[m]];
+  size_t pending = 0;
+  for (size_t k = (n - m) + 1; k > 0; --k) {
+    uint8_t *w = u + (k - 1);
+    uint8_t q = F->neg[F->red[F->red[w[m]] * lead]];
+    // The leading term cancels.
+    w[m] = 0;
+    if (q) {
+      for (size_t i = 0; i < m; ++i) {
+        w[i] += q * v[i];
+      }
+    }
+    if (++pending == F->lazy) {
+      poly_reduce(u, (k - 1) + m, F);
+      pending = 0;
+    }
+  }
+  poly_reduce(u, m, F);
+}
+
 // Calculate res = a mod b, where a and b are polynomials over Fp.
 void poly_div(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
   if (!res) {
@@ -97,19 +221,29 @@ void poly_div(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
     return;
   }
 
-  // At this point a.deg >= b.deg
-  res->deg = b->deg - 1;
+  // At this point a.deg >= b.deg. Read a.deg before res.deg is
+  // overwritten, since a may be passed as res.
+  size_t n = a->deg;
+  size_t m = b->deg;
 
-  uint8_t n = a->deg;
-  uint8_t m = b->deg;
+  // The remainder of a division by a constant is zero.
+  res->deg = m ? m - 1 : 0;
 
   uint8_t *u = res->coeff;
   uint8_t *v = b->coeff;
 
+  const modp_t *F = poly_modp_get(p);
+  if (F) {
+    poly_div_lazy(u, n, v, m, F);
+    poly_normalize_deg(res);
+    return;
+  }
+
+  uint8_t lead = inverse(v[m], p);
   uint8_t q;
   uint8_t w;
   for (size_t k = (n - m) + 1; k > 0; --k) {
-    q = u[(k - 1) + m] * inverse(v[m], p);
+    q = (u[(k - 1) + m] * lead) % p;
     for (size_t i = m + (k - 1) + 1; i > (k - 1); --i) {
       w = (q * v[(i - 1) - (k - 1)]) % p;
       w = complement(w, p);
@@ -119,41 +253,207 @@ void poly_div(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
   poly_normalize_deg(res);
 }
 
+// Set res = a * b with the sums reduced only every F->lazy rows, for a
+// and b of na and nb coefficients. res must be zero.
+static void poly_mul_lazy(uint8_t *res, const uint8_t *a, size_t na, const uint8_t *b,
+                          size_t nb, const modp_t *F) {
+  size_t pending = 0;
+  for (size_t i = 0; i < na; ++i) {
+    uint8_t c = a[i];
+    if (c) {
+      for (size_t j = 0; j < nb; ++j) {
+        res[i + j] += c * b[j];
+      }
+    }
+    if (++pending == F->lazy) {
+      // Rows since the last reduction only touched res[i + 1 - pending ..].
+      poly_reduce(res + (i + 1 - pending), pending + nb - 1, F);
+      pending = 0;
+    }
+  }
+  poly_reduce(res, na + nb - 1, F);
+}
+
+// Set res[0 .. na + nb - 1) = a * b by the schoolbook method.
+static void poly_mul_school(uint8_t *res, const uint8_t *a, size_t na, const uint8_t *b,
+                            size_t nb, uint8_t p, const modp_t *F) {
+  memset(res, 0, sizeof(*res) * (na + nb - 1));
+  if (F) {
+    poly_mul_lazy(res, a, na, b, nb, F);
+    return;
+  }
+  for (size_t i = 0; i < na; ++i) {
+    for (size_t j = 0; j < nb; ++j) {
+      res[i + j] = (res[i + j] + a[i] * b[j]) % p;
+    }
+  }
+}
+
 // Set res = a * b mod p. Must be guaranteed res is niether a nor b.
 void poly_mul(poly_t *res, poly_t *a, poly_t *b, uint8_t p) {
   if (!res) {
     return;
   }
-  memset(res->coeff, 0, sizeof(*res->coeff) * (a->deg + b->deg + 1));
-  for (size_t i = 0; i <= a->deg; ++i) {
-    for (size_t j = 0; j <= b->deg; ++j) {
-      res->coeff[i + j] = (res->coeff[i + j] + a->coeff[i] * b->coeff[j]) % p;
-    }
+  poly_mul_school(res->coeff, a->coeff, a->deg + 1, b->coeff, b->deg + 1, p, poly_modp_get(p));
+  res->deg = a->deg + b->deg;
+}
+
+// Karatsuba multiplication pays off from about 48 coefficients per factor
+// over GF(3), see bench_karatsuba in gf_bench.
+#define POLY_KARATSUBA_MIN 48
+
+size_t poly_karatsuba_min = POLY_KARATSUBA_MIN;
+
+// Sums of a few residues are reduced by conditional subtraction, which is
+// cheaper than a table lookup or %.
+static inline uint8_t modp_add(uint8_t x, uint8_t y, uint8_t p) {
+  unsigned int s = (unsigned int)x + y;
+  return (s >= p) ? s - p : s;
+}
+
+// Return x - y - z mod p.
+static inline uint8_t modp_sub2(uint8_t x, uint8_t y, uint8_t z, uint8_t p) {
+  unsigned int s = (unsigned int)x + 2 * p - y - z;
+  s = (s >= 2 * p) ? s - 2 * p : s;
+  return (s >= p) ? s - p : s;
+}
+
+// Scratch poly_kmul needs for factors of n coefficients.
+static size_t poly_kmul_scratch_size(size_t n) {
+  size_t size = 0;
+  while (n >= poly_karatsuba_min) {
+    // Two half sums and their product.
+    size_t k = n - n / 2;
+    size += 4 * k - 1;
+    n = k;
+  }
+  return size;
+}
+
+// Set r[0 .. 2n - 1) = a * b for a and b of n coefficients, splitting them
+// into halves until they are shorter than poly_karatsuba_min. tmp holds
+// poly_kmul_scratch_size(n) bytes.
+static void poly_kmul(uint8_t *r, const uint8_t *a, const uint8_t *b, size_t n, uint8_t *tmp,
+                      uint8_t p, const modp_t *F) {
+  if (n < poly_karatsuba_min) {
+    poly_mul_school(r, a, n, b, n, p, F);
+    return;
+  }
+
+  // a = a0 + x^h a1 with h coefficients in a0 and k >= h in a1, same for b.
+  size_t h = n / 2;
+  size_t k = n - h;
+  uint8_t *sa = tmp;
+  uint8_t *sb = sa + k;
+  uint8_t *z1 = sb + k;
+  uint8_t *next = z1 + (2 * k - 1);
+
+  // r = a0 b0 + x^2h a1 b1.
+  poly_kmul(r, a, b, h, next, p, F);
+  r[2 * h - 1] = 0;
+  poly_kmul(r + 2 * h, a + h, b + h, k, next, p, F);
+
+  // z1 = (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 = a0 b1 + a1 b0.
+  for (size_t i = 0; i < k; ++i) {
+    sa[i] = (i < h) ? modp_add(a[i], a[h + i], p) : a[h + i];
+    sb[i] = (i < h) ? modp_add(b[i], b[h + i], p) : b[h + i];
+  }
+  poly_kmul(z1, sa, sb, k, next, p, F);
+  for (size_t i = 0; i < 2 * k - 1; ++i) {
+    z1[i] = modp_sub2(z1[i], (i < 2 * h - 1) ? r[i] : 0, r[2 * h + i], p);
+  }
+
+  for (size_t i = 0; i < 2 * k - 1; ++i) {
+    r[h + i] = modp_add(r[h + i], z1[i], p);
   }
+}
+
+size_t poly_mul_scratch_size(uint16_t deg) {
+  size_t n = (size_t)deg + 1;
+  // Both factors padded to n coefficients, the product and poly_kmul's own.
+  return 4 * n + poly_kmul_scratch_size(n) + sizeof(void *);
+}
+
+void poly_mul_scratch(poly_t *res, poly_t *a, poly_t *b, uint8_t p, arena_t *scratch) {
+  if (!res) {
+    return;
+  }
+  size_t na = a->deg + 1;
+  size_t nb = b->deg + 1;
+  size_t n = MAX(na, nb);
+  if ((na < poly_karatsuba_min) || (nb < poly_karatsuba_min)) {
+    poly_mul(res, a, b, p);
+    return;
+  }
+
+  size_t size = 4 * n + poly_kmul_scratch_size(n);
+  size_t mark = scratch ? scratch->top : 0;
+  uint8_t *buf = scratch ? arena_alloc(scratch, size) : xkcalloc(size, 1);
+  if (!buf) {
+    poly_mul(res, a, b, p);
+    return;
+  }
+
+  // Pad the shorter factor with zeros.
+  uint8_t *pa = buf;
+  uint8_t *pb = pa + n;
+  uint8_t *r = pb + n;
+  memcpy(pa, a->coeff, na);
+  memcpy(pb, b->coeff, nb);
+  poly_kmul(r, pa, pb, n, r + 2 * n, p, poly_modp_get(p));
+
+  memcpy(res->coeff, r, na + nb - 1);
   res->deg = a->deg + b->deg;
+
+  if (scratch) {
+    scratch->top = mark;
+  } else {
+    kfree(buf);
+  }
 }
 
-void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p) {
+void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p, arena_t *scratch) {
   if (!res) {
     return;
   }
 
-  poly_t *base = poly_create_zero(I->deg + I->deg);
-  memcpy(base->coeff, a->coeff, (a->deg + 1) * sizeof(*base->coeff));
-  base->deg = a->deg;
+  size_t mark = scratch ? scratch->top : 0;
+
+  poly_t *base = poly_create_scratch(scratch, I->deg + I->deg);
 
   // Temporary buffer
-  poly_t *buff = poly_create_zero(I->deg + I->deg);
+  poly_t *buff = poly_create_scratch(scratch, I->deg + I->deg);
 
   // Set prod equal to 1. Prod holds the result.
-  poly_t *prod = poly_create_zero(I->deg + I->deg);
+  poly_t *prod = poly_create_scratch(scratch, I->deg + I->deg);
+
+  // Without scratch from the caller, allocate the temporaries of the
+  // products once rather than in every poly_mul_scratch.
+  arena_t local;
+  arena_t *mul_scratch = scratch;
+  uint8_t *mul_buf = NULL;
+  if (!scratch && (I->deg >= poly_karatsuba_min)) {
+    size_t size = poly_mul_scratch_size(I->deg);
+    mul_buf = xkmalloc(size);
+    if (mul_buf) {
+      arena_init(&local, mul_buf, size);
+      mul_scratch = &local;
+    }
+  }
+
+  if (!base || !buff || !prod) {
+    goto out;
+  }
+
+  memcpy(base->coeff, a->coeff, (a->deg + 1) * sizeof(*base->coeff));
+  base->deg = a->deg;
   *prod->coeff = 1;
 
-  int8_t *tmp = NULL;
+  uint8_t *tmp = NULL;
   while (exp > 0) {
     if ((exp % 2) != 0) {
       // Set buff = prod * base
-      poly_mul(buff, prod, base, p);
+      poly_mul_scratch(buff, prod, base, p, mul_scratch);
       poly_div(buff, buff, I, p);
       // Swap buff and prod.
       tmp = prod->coeff;
@@ -162,7 +462,7 @@ void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p) {
       buff->coeff = tmp;
     }
     // Set buff = base * base;
-    poly_mul(buff, base, base, p);
+    poly_mul_scratch(buff, base, base, p, mul_scratch);
     poly_div(buff, buff, I, p);
     exp = exp / 2;
     // Swap buff and base.
@@ -175,8 +475,103 @@ void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p) {
   memcpy(res->coeff, prod->coeff, sizeof(*prod->coeff) * (prod->deg + 1));
   res->deg = prod->deg;
 
+out:
   // Clean up.
+  kfree(mul_buf);
+  if (scratch) {
+    scratch->top = mark;
+    return;
+  }
   poly_destroy(prod);
   poly_destroy(buff);
   poly_destroy(base);
 }
+
+// Set a = a - c * x^j * b over Fp. a must have room for deg(b) + j + 1 coefficients.
+static void poly_submul_shift(poly_t *a, poly_t *b, uint8_t c, uint16_t j, uint8_t p,
+                              const modp_t *F) {
+  for (size_t i = a->deg + 1; i <= b->deg + j; ++i) {
+    a->coeff[i] = 0;
+  }
+  if (F) {
+    // -c * b[i] + a[i + j] is below p^2 and fits.
+    uint8_t nc = F->neg[c];
+    for (size_t i = 0; i <= b->deg; ++i) {
+      a->coeff[i + j] = F->red[a->coeff[i + j] + nc * b->coeff[i]];
+    }
+  } else {
+    for (size_t i = 0; i <= b->deg; ++i) {
+      a->coeff[i + j] = (a->coeff[i + j] + complement((c * b->coeff[i]) % p, p)) % p;
+    }
+  }
+  a->deg = MAX(a->deg, b->deg + j);
+  poly_normalize_deg(a);
+}
+
+static inline bool poly_is_zero(const poly_t *a) {
+  return (a->deg == 0) && (*a->coeff == 0);
+}
+
+void poly_inverse(poly_t *res, poly_t *a, poly_t *I, uint8_t p, arena_t *scratch) {
+  if (!res) {
+    return;
+  }
+
+  size_t mark = scratch ? scratch->top : 0;
+  const modp_t *F = poly_modp_get(p);
+
+  poly_t *r0 = poly_create_scratch(scratch, I->deg + I->deg);
+  poly_t *r1 = poly_create_scratch(scratch, I->deg + I->deg);
+  poly_t *s0 = poly_create_scratch(scratch, I->deg + I->deg);
+  poly_t *s1 = poly_create_scratch(scratch, I->deg + I->deg);
+  poly_t *tmp;
+
+  if (!r0 || !r1 || !s0 || !s1) {
+    goto out;
+  }
+
+  // Keep s0 * a = r0 and s1 * a = r1 mod (I) while the remainders shrink.
+  memcpy(r0->coeff, I->coeff, (I->deg + 1) * sizeof(*r0->coeff));
+  r0->deg = I->deg;
+  poly_div(r1, a, I, p);
+  *s1->coeff = 1;
+
+  while (r1->deg > 0) {
+    // Set r0 = r0 mod r1 one leading term at a time.
+    while (!poly_is_zero(r0) && r0->deg >= r1->deg) {
+      uint8_t lead = F ? F->inv[r1->coeff[r1->deg]] : inverse(r1->coeff[r1->deg], p);
+      uint8_t c = F ? F->red[r0->coeff[r0->deg] * lead] : (r0->coeff[r0->deg] * lead) % p;
+      uint16_t j = r0->deg - r1->deg;
+      poly_submul_shift(r0, r1, c, j, p, F);
+      poly_submul_shift(s0, s1, c, j, p, F);
+    }
+    tmp = r0;
+    r0 = r1;
+    r1 = tmp;
+    tmp = s0;
+    s0 = s1;
+    s1 = tmp;
+  }
+
+  // r1 is now the gcd, a constant since I is irreducible. It is zero
+  // only if a = 0 mod (I), which has no inverse.
+  memset(res->coeff, 0, (s1->deg + 1) * sizeof(*res->coeff));
+  res->deg = 0;
+  if (*r1->coeff) {
+    uint8_t c = inverse(*r1->coeff, p);
+    for (size_t i = 0; i <= s1->deg; ++i) {
+      res->coeff[i] = (s1->coeff[i] * c) % p;
+    }
+    res->deg = s1->deg;
+  }
+
+out:
+  if (scratch) {
+    scratch->top = mark;
+    return;
+  }
+  poly_destroy(s1);
+  poly_destroy(s0);
+  poly_destroy(r1);
+  poly_destroy(r0);
+}
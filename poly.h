@@ -2,14 +2,22 @@
 
 #include <linux/types.h>
 
-// Polynomial.
+#include "utils.h"
+
+// Polynomial. The functions below that create one allocate its
+// coefficients in the same block, right after it.
 typedef struct {
-  uint8_t deg;     // Degree of polynomial.
+  uint16_t deg;    // Degree of polynomial. Wider than coefficients, as a
+                   // product of two factors of degree up to 255 can exceed 255.
   uint8_t *coeff;  // Array of coefficients.
 } poly_t;
 
+/* Build lookup tables for arithmetic mod the primes up to 16. Until this
+   is called, every coefficient operation is reduced with %. */
+void poly_init_tables(void);
+
 /* Initialize a polynomial. */
-poly_t *poly_from_array(uint8_t deg, uint8_t *coeff);
+poly_t *poly_from_array(uint16_t deg, uint8_t *coeff);
 
 /* Destroy a given polynomial. */
 void poly_destroy(poly_t *a);
@@ -20,17 +28,51 @@ bool poly_eq(const poly_t *a, const poly_t *b);
 /* Return a zero polynomial of the given length.*/
 poly_t *poly_create_zero(size_t len);
 
+/* Return a zero polynomial of the given length allocated from scratch,
+   or from the general purpose slabs if scratch is NULL. */
+poly_t *poly_create_scratch(arena_t *scratch, size_t len);
+
+/* Scratch space poly_fpowm needs for a modulus of the given degree. */
+size_t poly_fpowm_scratch_size(uint16_t deg);
+
 /* Set res = a + b, where a and b are polynomials over Fp. */
 void poly_sum(poly_t *res, poly_t *a, poly_t *b, uint8_t p);
 
+/* Set res = a - b, where a and b are polynomials over Fp. */
+void poly_diff(poly_t *res, poly_t *a, poly_t *b, uint8_t p);
+
 /* Set res = a mod b, where a and b are polynomials over Fp. */
 void poly_div(poly_t *res, poly_t *a, poly_t *b, uint8_t p);
 
 /* Calculate res = a * b. */
 void poly_mul(poly_t *res, poly_t *a, poly_t *b, uint8_t p);
 
-/* Calculate res = a^exp mod (I) */
-void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p);
+/* Factors with fewer coefficients than this are multiplied by the
+   schoolbook method in poly_mul_scratch. Tunable for benchmarking. */
+extern size_t poly_karatsuba_min;
+
+/* Scratch space poly_mul_scratch needs for factors of degree up to deg. */
+size_t poly_mul_scratch_size(uint16_t deg);
+
+/* Calculate res = a * b as poly_mul, by Karatsuba multiplication once both
+   factors have poly_karatsuba_min coefficients. Temporaries come from scratch
+   if it is not NULL, in which case it should have poly_mul_scratch_size(deg)
+   bytes free, and are otherwise allocated once per call. Falls back to
+   poly_mul if there is no room for them. */
+void poly_mul_scratch(poly_t *res, poly_t *a, poly_t *b, uint8_t p, arena_t *scratch);
+
+/* Calculate res = a^exp mod (I). Temporaries come from scratch if it is
+   not NULL, in which case it must have poly_fpowm_scratch_size(I->deg)
+   bytes free, and are given back to it on return. */
+void poly_fpowm(poly_t *res, poly_t *a, uint64_t exp, poly_t *I, uint8_t p, arena_t *scratch);
+
+/* Scratch space poly_inverse needs for a modulus of the given degree. */
+size_t poly_inverse_scratch_size(uint16_t deg);
+
+/* Calculate res = a^-1 mod (I) with the extended Euclidean algorithm, in
+   O(deg(I)^2) coefficient operations. res is zero if a = 0 mod (I).
+   Temporaries come from scratch as in poly_fpowm. */
+void poly_inverse(poly_t *res, poly_t *a, poly_t *I, uint8_t p, arena_t *scratch);
 
 /* Normalize the degree of the given polynomial. */
 void poly_normalize_deg(poly_t *a);
@@ -0,0 +1,116 @@
+#pragma once
+
+/* Interface of the /dev/rngdrv<N> devices shared with user space. */
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Maximum order of a recurrence given by all its coefficients. */
+#define RNGDRV_MAX_ORD 80
+
+/* Maximum order of a recurrence given by its nonzero coefficients. */
+#define RNGDRV_MAX_SPARSE_ORD 4096
+
+/* Maximum number of nonzero coefficients of such a recurrence, so that a
+   step costs no more than one of the longest recurrence given in full. */
+#define RNGDRV_MAX_SPARSE_TAPS RNGDRV_MAX_ORD
+
+/* Size of the data area of the mapped ring, a power of two. */
+#define RNGDRV_RING_SIZE (64 * 1024)
+
+/* The ring is mapped as one control page followed by RNGDRV_RING_SIZE bytes
+   of data, at offset 0 of the file. Byte i of the stream sits at data
+   offset i % RNGDRV_RING_SIZE. The driver only advances head, the consumer
+   only advances tail. A consumer loads head with acquire semantics, uses
+   the bytes in [tail, head) and stores the new tail with release semantics. */
+struct rngdrv_ring_ctl {
+        __u64 head;     /* Bytes produced so far. */
+        __u64 tail;     /* Bytes consumed so far. */
+        __u32 size;     /* RNGDRV_RING_SIZE. */
+};
+
+#define RNGDRV_IOC_MAGIC 'r'
+
+/* Fill the free space of the ring. Returns the number of bytes added. The
+   ring is empty when first mapped, so this comes before the first use. The
+   bytes are taken from the file's stream and advance the file offset like
+   a read. */
+#define RNGDRV_IOC_RING_FILL _IO(RNGDRV_IOC_MAGIC, 1)
+
+/* A recurrence v[n + ord] = cnst + coeffs[0] v[n] + ... + coeffs[ord - 1] v[n + ord - 1]
+   over GF(2^width), starting from vals[0 .. ord). */
+struct rngdrv_config {
+        __u32 width;    /* 8, 16 or 32. */
+        __u32 ord;
+        __u32 cnst;
+        __u32 coeffs[RNGDRV_MAX_ORD];
+        __u32 vals[RNGDRV_MAX_ORD];
+};
+
+/* New initial values for the recurrence of one file. */
+struct rngdrv_seed {
+        __u32 vals[RNGDRV_MAX_ORD];
+};
+
+/* Install a new recurrence for the device the file was opened on. Its open
+   files switch to it on their next access and keep their offsets. Other
+   devices are not affected. Needs CAP_SYS_ADMIN. */
+#define RNGDRV_IOC_SET_CONFIG _IOW(RNGDRV_IOC_MAGIC, 2, struct rngdrv_config)
+
+/* Restart this file at offset 0 from the given initial values, with the
+   coefficients and constant of the current recurrence. The file then no
+   longer follows RNGDRV_IOC_SET_CONFIG. With a NULL argument, restart it
+   from the recurrence of its device and follow it again. Fails with EINVAL
+   if the recurrence is longer than RNGDRV_MAX_ORD. */
+#define RNGDRV_IOC_RESEED _IOW(RNGDRV_IOC_MAGIC, 3, struct rngdrv_seed)
+
+/* A nonzero coefficient: coeffs[idx] = coeff. */
+struct rngdrv_tap {
+        __u32 idx;
+        __u32 coeff;
+};
+
+/* The recurrence of struct rngdrv_config, given by the n_taps coefficients
+   that are not zero, by strictly increasing index. Each step costs one
+   multiplication per tap, so long recurrences with few taps are as fast
+   as short ones. */
+struct rngdrv_sparse_config {
+        __u32 width;    /* 8, 16 or 32. */
+        __u32 ord;      /* At most RNGDRV_MAX_SPARSE_ORD. */
+        __u32 cnst;
+        __u32 n_taps;   /* At most RNGDRV_MAX_SPARSE_TAPS. */
+        __u64 taps;     /* Address of n_taps struct rngdrv_tap. */
+        __u64 vals;     /* Address of ord __u32 initial values. */
+};
+
+/* RNGDRV_IOC_SET_CONFIG for a sparse recurrence. */
+#define RNGDRV_IOC_SET_SPARSE_CONFIG _IOW(RNGDRV_IOC_MAGIC, 4, struct rngdrv_sparse_config)
+
+/* Maximum number of lanes of a file. */
+#define RNGDRV_MAX_LANES 1024
+
+/* Maximum of n_lanes * block. */
+#define RNGDRV_MAX_LANE_FRAME (64 * 1024)
+
+/* Maximum of n_lanes * ord, the number of initial values of all lanes. */
+#define RNGDRV_MAX_LANE_VALS (1 << 18)
+
+/* n_lanes copies of the current recurrence of the device, with its
+   coefficients and constant, each from its own initial values. With
+   block 0, the output interleaves the lanes one step at a time: value k
+   of lane 0, value k of lane 1, and so on. Otherwise it is block bytes
+   of lane 0, then block bytes of lane 1, and so on, block being a
+   multiple of the width in bytes. */
+struct rngdrv_lanes_config {
+        __u32 n_lanes;  /* At most RNGDRV_MAX_LANES, 0 to stop. */
+        __u32 block;    /* n_lanes * block at most RNGDRV_MAX_LANE_FRAME. */
+        __u64 vals;     /* Address of n_lanes * ord __u32 initial values, lane after lane. */
+};
+
+/* Restart this file at offset 0 as the given lanes. The file then no longer
+   follows RNGDRV_IOC_SET_CONFIG and becomes a stream: reads continue where
+   the last one stopped whatever their offset, llseek fails with ESPIPE
+   and nothing is prefilled. n_lanes 0 does what RNGDRV_IOC_RESEED does
+   with a NULL argument, which also ends lanes mode, as does any reseed.
+   Fails with EINVAL on shared devices. */
+#define RNGDRV_IOC_SET_LANES _IOW(RNGDRV_IOC_MAGIC, 5, struct rngdrv_lanes_config)
@@ -0,0 +1,58 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rngdrv
+
+#if !defined(_RNGDRV_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _RNGDRV_TRACE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rngdrv_read_enter,
+
+        TP_PROTO(size_t count, loff_t pos),
+
+        TP_ARGS(count, pos),
+
+        TP_STRUCT__entry(
+                __field(size_t, count)
+                __field(loff_t, pos)
+        ),
+
+        TP_fast_assign(
+                __entry->count = count;
+                __entry->pos = pos;
+        ),
+
+        TP_printk("count=%zu pos=%lld", __entry->count, __entry->pos)
+);
+
+/* gen_ns is the time spent in crs_generate during the read. */
+TRACE_EVENT(rngdrv_read_exit,
+
+        TP_PROTO(size_t count, ssize_t ret, u64 gen_ns),
+
+        TP_ARGS(count, ret, gen_ns),
+
+        TP_STRUCT__entry(
+                __field(size_t, count)
+                __field(ssize_t, ret)
+                __field(u64, gen_ns)
+        ),
+
+        TP_fast_assign(
+                __entry->count = count;
+                __entry->ret = ret;
+                __entry->gen_ns = gen_ns;
+        ),
+
+        TP_printk("count=%zu ret=%zd gen_ns=%llu", __entry->count, __entry->ret,
+                  __entry->gen_ns)
+);
+
+#endif /* _RNGDRV_TRACE_H */
+
+/* This header lives next to driver.c rather than under include/trace/events. */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rngdrv_trace
+#include <trace/define_trace.h>
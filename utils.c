@@ -59,3 +59,19 @@ void *xkcalloc(size_t nmemb, size_t size) {
     return NULL;
   return res;
 }
+
+void arena_init(arena_t *arena, void *buf, size_t size) {
+  arena->buf = buf;
+  arena->size = size;
+  arena->top = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+  // Keep every allocation pointer-aligned.
+  size_t start = (arena->top + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  if ((start > arena->size) || (size > arena->size - start)) {
+    return NULL;
+  }
+  arena->top = start + size;
+  return memset(arena->buf + start, 0, size);
+}
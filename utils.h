@@ -15,3 +15,16 @@ uint64_t fpow(uint8_t base, uint8_t exp);
 void *xkcalloc(size_t nmemb, size_t size);
 
 void *xkmalloc(size_t size);
+
+// Bump allocator over a caller-provided buffer. Memory is given back
+// by restoring top to a value saved earlier.
+typedef struct {
+  uint8_t *buf;
+  size_t size;
+  size_t top;
+} arena_t;
+
+void arena_init(arena_t *arena, void *buf, size_t size);
+
+// Return size bytes of zeroed memory, or NULL if the arena is exhausted.
+void *arena_alloc(arena_t *arena, size_t size);